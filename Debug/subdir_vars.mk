@@ -10,78 +10,96 @@ C_SRCS += \
 ../Project_Khaled_Ahmed.c \
 ../adc0.c \
 ../adc1.c \
+../capture.c \
 ../clock.c \
 ../gpio.c \
 ../nvic.c \
 ../project.c \
 ../spi1.c \
+../stream.c \
 ../tm4c123gh6pm_startup_ccs.c \
 ../uart0.c \
+../udma.c \
 ../wait.c 
 
 C_DEPS += \
 ./Project_Khaled_Ahmed.d \
 ./adc0.d \
 ./adc1.d \
+./capture.d \
 ./clock.d \
 ./gpio.d \
 ./nvic.d \
 ./project.d \
 ./spi1.d \
+./stream.d \
 ./tm4c123gh6pm_startup_ccs.d \
 ./uart0.d \
+./udma.d \
 ./wait.d 
 
 OBJS += \
 ./Project_Khaled_Ahmed.obj \
 ./adc0.obj \
 ./adc1.obj \
+./capture.obj \
 ./clock.obj \
 ./gpio.obj \
 ./nvic.obj \
 ./project.obj \
 ./spi1.obj \
+./stream.obj \
 ./tm4c123gh6pm_startup_ccs.obj \
 ./uart0.obj \
+./udma.obj \
 ./wait.obj 
 
 OBJS__QUOTED += \
 "Project_Khaled_Ahmed.obj" \
 "adc0.obj" \
 "adc1.obj" \
+"capture.obj" \
 "clock.obj" \
 "gpio.obj" \
 "nvic.obj" \
 "project.obj" \
 "spi1.obj" \
+"stream.obj" \
 "tm4c123gh6pm_startup_ccs.obj" \
 "uart0.obj" \
+"udma.obj" \
 "wait.obj" 
 
 C_DEPS__QUOTED += \
 "Project_Khaled_Ahmed.d" \
 "adc0.d" \
 "adc1.d" \
+"capture.d" \
 "clock.d" \
 "gpio.d" \
 "nvic.d" \
 "project.d" \
 "spi1.d" \
+"stream.d" \
 "tm4c123gh6pm_startup_ccs.d" \
 "uart0.d" \
+"udma.d" \
 "wait.d" 
 
 C_SRCS__QUOTED += \
 "../Project_Khaled_Ahmed.c" \
 "../adc0.c" \
 "../adc1.c" \
+"../capture.c" \
 "../clock.c" \
 "../gpio.c" \
 "../nvic.c" \
 "../project.c" \
 "../spi1.c" \
+"../stream.c" \
 "../tm4c123gh6pm_startup_ccs.c" \
 "../uart0.c" \
+"../udma.c" \
 "../wait.c" 
 
 
@@ -14,7 +14,7 @@
 //
 //   AIN3/PE0
 //   AIN2/PE1
-//   LDAC/PD2
+//   LDAC/PD2 (WT3CCP0 when strobed by the LDAC timer)
 // UART Interface:
 //   U0TX (PA1) and U0RX (PA0) are connected to the 2nd controller
 //   The USB on the 2nd controller enumerates to an ICDI interface and a virtual COM port
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
 #include "tm4c123gh6pm.h"
 #include "clock.h"
 #include "gpio.h"
@@ -39,16 +40,119 @@
 #include "uart0.h"
 #include "adc0.h"
 #include "adc1.h"
+#include "udma.h"
+#include "stream.h"
+#include "capture.h"
 
 
 // Pin
 #define LDAC PORTD,2
 #define AIN2_INPUTA PORTE,1
 #define AIN1_INPUTB PORTE,2
-#define LUT_SIZE 2048
+#define LUT_BITS 11
+#define LUT_SIZE (1 << LUT_BITS)
 #define DAC_A_OFFSET  0
 #define DAC_B_OFFSET  0
-#define REF_FREQUENCY 40
+
+// DDS sample clock
+// The LUT index is the top LUT_BITS of a 32-bit phase accumulator, so one
+// overflow of the accumulator is exactly one output period
+#define SYSTEM_CLOCK  40000000
+#define TIMER1_LOAD   488                   // default sample period (81.8 kHz)
+#define MIN_SAMPLE_LOAD 79                  // two SPI frames, FSS gaps and the LDAC pulse
+#define PHASE_SHIFT   (32 - LUT_BITS)
+#define PHASE_SCALE   4294967296.0
+#define PI_F          3.14159265f
+
+// Linear interpolation weight: the accumulator bits below the table index, 14 bits so
+// (s1 - s0) * fraction stays inside 32 bits for a full-scale step
+#define INTERP_BITS   14
+
+// Table read modes of the specialized Timer1 handlers: bit 0 quarter-wave sine,
+// bit 1 linear interpolation; TABLE_GENERAL leaves the choice to calcSampleA/B
+#define TABLE_SHAPE           0
+#define TABLE_QUARTER         1
+#define TABLE_SHAPE_INTERP    2
+#define TABLE_QUARTER_INTERP  3
+#define TABLE_GENERAL         4
+
+// Quarter-wave sine: QUARTER_SIZE+1 entries cover 0..pi/2, folding gives a
+// 2^SINE_BITS entry sine indexed by the top SINE_BITS of the accumulator
+// (LUT_QUARTER_SINE is precomputed in flash for SINE_BITS 12)
+#define SINE_BITS     12
+#define QUARTER_SIZE  (1 << (SINE_BITS - 2))
+
+// Calibration: opamp output voltage (Q12, 1 V = 4096, +/-8 V span) to DAC code,
+// CAL_SEGMENTS linear segments of 1 << CAL_SHIFT steps each
+#define VOLT_Q12      4096.0f
+#define CAL_SEGMENTS  512
+#define CAL_SHIFT     7
+#define VOLT_MAX_Q12  (5 * 4096)            // opamp output range +/-5 V
+
+// uDMA output: each Timer1 timeout requests one sample period (DAC A word then
+// DAC B word) from a ping-pong buffer into SSI1, the CPU refills the idle half
+#define DMA_SAMPLES   64
+
+// Parameter updates: a new shape is built into a spare table and swapped in, together
+// with the channel scale, when the accumulator wraps. Channels with longer periods than
+// SWAP_MAX_PERIOD take the update at once rather than holding up the command
+#define SWAP_MAX_PERIOD 0.1f                // seconds
+#define SWAP_TIMEOUT  (SYSTEM_CLOCK / 5)    // cycles to wait for the spare table
+
+// Arbitrary waveform upload: after "arb" the host sends a binary block (length, sample
+// format, samples, CRC-16/CCITT) that is received straight into the spare table
+#define ARB_MAX_LENGTH  65535
+#define ARB_TIMEOUT     SYSTEM_CLOCK        // cycles to wait for each byte (1 s)
+
+// Streaming: the host sends Q15 samples (little endian) that the sample engine plays at
+// the stream rate. A UART frame is 10 bits, so the link carries UART0_BAUD / 20 samples/s
+#define UART0_BAUD      115200
+#define STREAM_END      -32768              // sample value that ends a stream
+#define STREAM_TIMEOUT  (2 * SYSTEM_CLOCK)  // cycles without data while the ring has room
+
+// Capture: volts at the IN connectors for a full-scale ADC code, and how long to wait for a trigger
+#define ADC_FULL_SCALE  5.0f
+#define CAPTURE_TIMEOUT (10 * SYSTEM_CLOCK)
+
+// Measurement: the processor reads every pair as it arrives, so the rate stays well below
+// capture's, and N is limited so N times the sum of squares fits 64 bits
+#define MEASURE_DEFAULT_SAMPLES 10000
+#define MEASURE_MAX_SAMPLES     100000
+#define MEASURE_MAX_RATE        100000
+#define MEASURE_HYSTERESIS      8           // ADC codes either side of the crossing level, at least
+
+// Gain sweep plan: every point settles for whole periods lasting at least GAIN_SETTLE_TIME
+// (the DUT's slowest time constant), then integrates whole periods holding at least
+// GAIN_MIN_SAMPLES samples, which sets the noise floor of the measurement
+#define GAIN_DEFAULT_POINTS 10              // per decade
+#define GAIN_MAX_POINTS     500
+#define GAIN_SETTLE_PERIODS 1
+#define GAIN_SETTLE_TIME    0.002f          // seconds
+#define GAIN_MIN_PERIODS    2
+#define GAIN_MIN_SAMPLES    2048
+
+// LDAC strobe: Wide Timer 3A runs in PWM mode with the same period as Timer1
+// and drives PD2 low for the last LDAC_PULSE+1 cycles of every sample period,
+// so both DAC outputs update together on a jitter-free edge (min 100 ns low)
+#define LDAC_PULSE    7
+
+// Per-sample cost estimates (cycles) used by 'rate auto' until the ISR has been measured
+#define CYCLES_ISR_OVERHEAD    40           // entry, accumulator update, exit
+#define CYCLES_BLOCKING_WORD   85           // scale and calibrate one sample, sendData: SPI frame, BSY wait, readback
+#define CYCLES_PIPELINED_WORD  35           // scale and calibrate one sample, queue it in the TX FIFO
+#define CYCLES_DMA             60           // render cost per sample, amortized over a half buffer
+#define CYCLES_INTERP          25           // second table read and blend, per interpolating channel
+#define CYCLES_SWEEP           30           // tuning word step, per sweeping channel
+#define CYCLES_MODULATION      60           // modulation source and the AM/FM/PM update
+#define CPU_LOAD_TARGET        0.6          // leave the rest for the command interface
+
+// Cortex-M4 DWT cycle counter (not in tm4c123gh6pm.h)
+#define DWT_CTRL_R              (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT_R            (*((volatile uint32_t *)0xE0001004))
+#define DWT_CTRL_CYCCNTENA      0x00000001  // enable CYCCNT
+#define NVIC_DBG_INT_TRCENA     0x01000000  // enable DWT and ITM (DEMCR)
+#define DMA_CONTROL   (UDMA_CHCTL_DSTINC_NONE | UDMA_CHCTL_DSTSIZE_16 | UDMA_CHCTL_SRCINC_16 | UDMA_CHCTL_SRCSIZE_16 | \
+                       UDMA_CHCTL_ARBSIZE_2 | ((DMA_SAMPLES * 2 - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_PINGPONG)
 
 
 //-----------------------------------------------------------------------------
@@ -72,35 +176,388 @@ typedef enum _LEVEL
     L_ON = 1
 } LEVEL;
 
-uint16_t LUT_DATA_A [LUT_SIZE];
-uint16_t LUT_DATA_B [LUT_SIZE];
-uint16_t LUT_DATA_C [LUT_SIZE];
+typedef enum _OUTPUT
+{
+    OUT_ISR = 0,                // timer1Isr writes every sample to SSI1
+    OUT_DMA = 1                 // uDMA streams rendered samples to SSI1
+} OUTPUT;
+
+typedef enum _LDAC_MODE
+{
+    LDAC_GPIO = 0,              // sendData pulses LDAC after every word
+    LDAC_TIMER = 1,             // one hardware strobe per sample latches A and B simultaneously
+    LDAC_CS = 2                 // LDAC held low, each word updates its DAC on CS rising edge
+} LDAC_MODE;
+
+typedef enum _PIPELINE
+{
+    P_OFF = 0,                  // one blocking sendData per channel
+    P_ON = 1                    // both words queued in the SSI1 TX FIFO, ISR returns immediately
+} PIPELINE;
+
+typedef enum _WAVEFORM
+{
+    W_SINE = 0,
+    W_SQUARE = 1,
+    W_TRIANGLE = 2,
+    W_SAWTOOTH = 3,
+    W_ARB = 4                   // uploaded with arb, there is no builder to regenerate it
+} WAVEFORM;
+
+typedef struct _CAL_COEFFS
+{
+    float c3;                   // opamp output voltage to DAC voltage, cubic fit
+    float c2;
+    float c1;
+    float c0;
+    float gain;                 // DAC voltage to code
+    float offset;
+} CAL_COEFFS;
+
+typedef void (*LUT_BUILDER)(int16_t shape[], float Phase);
+
+typedef struct _WAVE_CONFIG
+{
+    bool built;                 // shape table holds waveform at phase
+    WAVEFORM waveform;          // last table built for the channel
+    float amplitude;
+    float offset;
+    float phase;
+} WAVE_CONFIG;
+
+typedef void (*WAVE_FUNCTION)(DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase);
+
+// Command table entry, the dispatcher checks the arguments against schema before calling handler
+typedef struct _COMMAND
+{
+    const char* name;
+    const char* alias;          // second accepted name, or NULL
+    const char* schema;         // one letter per argument, see isSchemaValid
+    void (*handler)(USER_DATA* data, uint8_t arg);
+    uint8_t arg;                // lets several commands share one handler
+    const char* help;
+} COMMAND;
+
+typedef enum _SINE_TABLE
+{
+    SINE_FULL = 0,              // sine built into the channel's LUT_SIZE shape table
+    SINE_QUARTER = 1            // sine folded from the shared quarter-wave table
+} SINE_TABLE;
+
+// Channel settings waiting for a period boundary, written by the main loop and
+// taken by the output path when the channel's accumulator wraps
+typedef struct _CHANNEL_UPDATE
+{
+    bool pending;
+    int16_t* shape;             // table to swap in, NULL keeps the current one
+    bool quarterSine;
+    uint32_t phaseOffset;
+    int32_t amplitude;
+    int32_t offset;
+} CHANNEL_UPDATE;
+
+typedef enum _SWEEP_MODE
+{
+    SWEEP_OFF = 0,
+    SWEEP_LINEAR = 1,           // tuning word steps by a constant per sample
+    SWEEP_LOG = 2               // tuning word grows by a constant ratio per sample
+} SWEEP_MODE;
+
+// Frequency sweep run by the output path. The tuning word is kept in Q32.32 so slow
+// sweeps still advance by a fraction of a frequency step every sample
+typedef struct _SWEEP
+{
+    SWEEP_MODE mode;
+    bool repeat;                // restart at the start frequency, else hold the stop frequency
+    float startFrequency;
+    float stopFrequency;
+    float duration;             // seconds
+    uint64_t start;             // tuning words, Q32.32
+    uint64_t stop;
+    uint64_t tuningWord;
+    int64_t step;               // linear: added per sample
+    int32_t ratio;              // log: (tuningWord >> 32) * ratio added per sample, Q32
+    uint32_t samples;           // samples per sweep
+    uint32_t remaining;
+} SWEEP;
+
+typedef enum _MODULATION
+{
+    MOD_OFF = 0,
+    MOD_AM = 1,                 // channel B scales channel A's amplitude
+    MOD_FM = 2,                 // channel B shifts channel A's tuning word
+    MOD_PM = 3                  // channel B shifts channel A's phase
+} MODULATION;
+
+typedef enum _DETECT_STATE
+{
+    DETECT_OFF = 0,
+    DETECT_SETTLE = 1,          // skipping whole periods while the DUT settles
+    DETECT_INTEGRATE = 2,       // accumulating I/Q over whole periods
+    DETECT_DONE = 3
+} DETECT_STATE;
+
+// Synchronous detection result for one input: the component at the DDS frequency
+typedef struct _DETECT_RESULT
+{
+    float amplitude;            // peak volts at the IN connector
+    float phase;                // degrees against the DDS phase, less a fixed pipeline delay
+} DETECT_RESULT;
+
+typedef struct _GAIN_PLAN
+{
+    float start;                // Hz
+    float stop;
+    bool log;                   // log spacing, else linear
+    uint16_t density;           // log: points per decade, linear: points in total
+    uint16_t points;
+} GAIN_PLAN;
+
+// Streamed statistics of one input in ADC codes, no samples are kept
+typedef struct _MEASURE
+{
+    uint32_t sum;
+    uint64_t sumSquares;
+    uint16_t min;
+    uint16_t max;
+    uint16_t low;                           // a rising crossing goes below low, then above high
+    uint16_t high;
+    bool armed;
+    uint32_t crossings;
+    uint32_t first;                         // sample numbers of the first and last crossing
+    uint32_t last;
+} MEASURE;
+
+typedef struct _ISR_STATS
+{
+    uint32_t count;             // timer1Isr runs
+    uint32_t minCycles;         // ISR duration (DWT)
+    uint32_t maxCycles;
+    uint64_t totalCycles;
+    uint32_t minLatency;        // timeout to ISR entry (Timer1 count)
+    uint32_t maxLatency;
+    uint32_t missed;            // periods with no ISR run
+    uint32_t overruns;          // ISR still running when the next period started
+    uint32_t lastEntry;
+} ISR_STATS;
+
+int16_t LUT_SHAPE [3][LUT_SIZE];           // normalized waveforms, Q15 (+/-1.0), one per channel and a spare
+int16_t* shapeA = LUT_SHAPE[0];             // tables the output path reads
+int16_t* shapeB = LUT_SHAPE[1];
+int16_t* spareShape = LUT_SHAPE[2];         // next shape is built here, never read by the output path
+volatile CHANNEL_UPDATE channelUpdates[2];
+SWEEP sweeps[2];
+MODULATION modulation = MOD_OFF;
+float modulationDepth = 0;      // as entered: AM fraction, FM deviation in Hz, PM deviation in units of pi
+int32_t modulationScale = 0;    // per-sample form: AM Q15, FM tuning word, PM accumulator (pi = 2^31)
+bool modulationStepsB = false;  // channel B is not an output, channel A advances the source
+bool streaming = false;         // streamIsr is the Timer1 handler
+DAC streamDac = DACA;
+uint32_t streamPhase = 0;       // a carry takes the next stream sample
+uint32_t streamTuningWord = 0;  // stream rate / sample rate, Q32
+int16_t streamSample = 0;       // held until the next carry, or through an underrun
+int32_t streamAmplitude = 0;    // Q12 volts, like the channel scale
+int32_t streamOffset = 0;
+volatile DETECT_STATE detectState = DETECT_OFF;  // detectIsr is the Timer1 handler when not off
+uint32_t detectSettle;          // periods left to skip
+uint32_t detectPeriods;         // periods left to integrate
+uint32_t detectPhase;           // DDS phase when the conversion being read was started
+uint32_t detectCount;           // samples integrated
+int64_t detectI[2];             // sum of x * cos, x * sin per input (ADC0 = IN1, ADC1 = IN2)
+int64_t detectQ[2];
+SINE_TABLE sineTable = SINE_QUARTER;
+bool quarterSineA = false;                  // channel reads LUT_QUARTER_SINE instead of its shape
+bool quarterSineB = false;
+bool interpolateA = false;                  // interpolate between table entries
+bool interpolateB = false;
+uint32_t phaseOffsetA = 0;                  // sine phase argument when reading the quarter table
+uint32_t phaseOffsetB = 0;
+int32_t amplitudeA = 0;                     // per-channel scaling applied per sample, Q12 volts
+int32_t offsetA = 0;
+int32_t amplitudeB = 0;
+int32_t offsetB = 0;
 int N_cycles_A = 0;
 int N_cycles_B = 0;
-float countA = 0;
-float countB = 0;
-float Step_Size_A;
-float Step_Size_B;
+uint32_t phaseA = 0;
+uint32_t phaseB = 0;
+uint32_t tuningWordA = 0;
+uint32_t tuningWordB = 0;
+float frequencyA = 0;
+float frequencyB = 0;
+float sampleRate = (float)SYSTEM_CLOCK / (TIMER1_LOAD + 1);
+bool autoRate = false;          // 'rate auto': re-pick the sample rate whenever the handler changes
 DAC DAC_SELECT_C;
 DIFFERENTIAL differential = OFF;
 LEVEL  level = L_OFF;
+OUTPUT outputMode = OUT_ISR;
+LDAC_MODE ldacMode = LDAC_TIMER;
+PIPELINE pipeline = P_ON;
+ISR_STATS isrStats;
+uint16_t dmaBuffer[2][DMA_SAMPLES * 2];
+uint16_t lastWordA;
+uint16_t lastWordB;
+WAVE_CONFIG waveConfig[2];
+CAL_COEFFS calCoeffs[2] =
+{
+    {-0.00009f, 0.0002f, -0.1888f, 1.0172f, 2005.1f, -7.7708f},
+    {-0.00009f, 0.0002f, -0.1888f, 1.0172f, 4096 / 2.048f, 0}
+};
+uint16_t calTable[2][CAL_SEGMENTS + 1];
+bool specializedIsr = true;     // install the per-configuration Timer1 handlers
+bool DC = false;                // last output command was dc
+DAC DACSELECT = DACA;           // dc output and voltage, used by level
+float DcVoltage = 0;
+int cycles_A = 0;               // burst counts restored by stop
+int cycles_B = 0;
+
+// sin(0..pi/2) in Q15, round(32767 * sin(pi/2 * i / QUARTER_SIZE)); const so it stays in flash
+const int16_t LUT_QUARTER_SINE [QUARTER_SIZE + 1] =
+{
+        0,    50,   101,   151,   201,   251,   302,   352,   402,   452,   503,   553,   603,   653,   704,   754,
+      804,   854,   905,   955,  1005,  1055,  1106,  1156,  1206,  1256,  1307,  1357,  1407,  1457,  1507,  1558,
+     1608,  1658,  1708,  1758,  1809,  1859,  1909,  1959,  2009,  2059,  2110,  2160,  2210,  2260,  2310,  2360,
+     2410,  2461,  2511,  2561,  2611,  2661,  2711,  2761,  2811,  2861,  2911,  2962,  3012,  3062,  3112,  3162,
+     3212,  3262,  3312,  3362,  3412,  3462,  3512,  3562,  3612,  3662,  3712,  3761,  3811,  3861,  3911,  3961,
+     4011,  4061,  4111,  4161,  4210,  4260,  4310,  4360,  4410,  4460,  4509,  4559,  4609,  4659,  4708,  4758,
+     4808,  4858,  4907,  4957,  5007,  5056,  5106,  5156,  5205,  5255,  5305,  5354,  5404,  5453,  5503,  5552,
+     5602,  5651,  5701,  5750,  5800,  5849,  5899,  5948,  5998,  6047,  6096,  6146,  6195,  6245,  6294,  6343,
+     6393,  6442,  6491,  6540,  6590,  6639,  6688,  6737,  6786,  6836,  6885,  6934,  6983,  7032,  7081,  7130,
+     7179,  7228,  7277,  7326,  7375,  7424,  7473,  7522,  7571,  7620,  7669,  7718,  7767,  7815,  7864,  7913,
+     7962,  8010,  8059,  8108,  8157,  8205,  8254,  8303,  8351,  8400,  8448,  8497,  8545,  8594,  8642,  8691,
+     8739,  8788,  8836,  8885,  8933,  8981,  9030,  9078,  9126,  9175,  9223,  9271,  9319,  9367,  9416,  9464,
+     9512,  9560,  9608,  9656,  9704,  9752,  9800,  9848,  9896,  9944,  9992, 10039, 10087, 10135, 10183, 10231,
+    10278, 10326, 10374, 10421, 10469, 10517, 10564, 10612, 10659, 10707, 10754, 10802, 10849, 10897, 10944, 10992,
+    11039, 11086, 11133, 11181, 11228, 11275, 11322, 11370, 11417, 11464, 11511, 11558, 11605, 11652, 11699, 11746,
+    11793, 11840, 11886, 11933, 11980, 12027, 12074, 12120, 12167, 12214, 12260, 12307, 12353, 12400, 12446, 12493,
+    12539, 12586, 12632, 12679, 12725, 12771, 12817, 12864, 12910, 12956, 13002, 13048, 13094, 13141, 13187, 13233,
+    13279, 13324, 13370, 13416, 13462, 13508, 13554, 13599, 13645, 13691, 13736, 13782, 13828, 13873, 13919, 13964,
+    14010, 14055, 14101, 14146, 14191, 14236, 14282, 14327, 14372, 14417, 14462, 14507, 14553, 14598, 14643, 14688,
+    14732, 14777, 14822, 14867, 14912, 14956, 15001, 15046, 15090, 15135, 15180, 15224, 15269, 15313, 15358, 15402,
+    15446, 15491, 15535, 15579, 15623, 15667, 15712, 15756, 15800, 15844, 15888, 15932, 15976, 16019, 16063, 16107,
+    16151, 16195, 16238, 16282, 16325, 16369, 16413, 16456, 16499, 16543, 16586, 16630, 16673, 16716, 16759, 16802,
+    16846, 16889, 16932, 16975, 17018, 17061, 17104, 17146, 17189, 17232, 17275, 17317, 17360, 17403, 17445, 17488,
+    17530, 17573, 17615, 17657, 17700, 17742, 17784, 17827, 17869, 17911, 17953, 17995, 18037, 18079, 18121, 18163,
+    18204, 18246, 18288, 18330, 18371, 18413, 18454, 18496, 18537, 18579, 18620, 18661, 18703, 18744, 18785, 18826,
+    18868, 18909, 18950, 18991, 19032, 19072, 19113, 19154, 19195, 19236, 19276, 19317, 19357, 19398, 19438, 19479,
+    19519, 19560, 19600, 19640, 19680, 19721, 19761, 19801, 19841, 19881, 19921, 19961, 20000, 20040, 20080, 20120,
+    20159, 20199, 20238, 20278, 20317, 20357, 20396, 20436, 20475, 20514, 20553, 20592, 20631, 20670, 20709, 20748,
+    20787, 20826, 20865, 20904, 20942, 20981, 21019, 21058, 21096, 21135, 21173, 21212, 21250, 21288, 21326, 21364,
+    21403, 21441, 21479, 21516, 21554, 21592, 21630, 21668, 21705, 21743, 21781, 21818, 21856, 21893, 21930, 21968,
+    22005, 22042, 22079, 22116, 22154, 22191, 22227, 22264, 22301, 22338, 22375, 22411, 22448, 22485, 22521, 22558,
+    22594, 22631, 22667, 22703, 22739, 22776, 22812, 22848, 22884, 22920, 22956, 22991, 23027, 23063, 23099, 23134,
+    23170, 23205, 23241, 23276, 23311, 23347, 23382, 23417, 23452, 23487, 23522, 23557, 23592, 23627, 23662, 23697,
+    23731, 23766, 23801, 23835, 23870, 23904, 23938, 23973, 24007, 24041, 24075, 24109, 24143, 24177, 24211, 24245,
+    24279, 24312, 24346, 24380, 24413, 24447, 24480, 24514, 24547, 24580, 24613, 24647, 24680, 24713, 24746, 24779,
+    24811, 24844, 24877, 24910, 24942, 24975, 25007, 25040, 25072, 25105, 25137, 25169, 25201, 25233, 25265, 25297,
+    25329, 25361, 25393, 25425, 25456, 25488, 25519, 25551, 25582, 25614, 25645, 25676, 25708, 25739, 25770, 25801,
+    25832, 25863, 25893, 25924, 25955, 25986, 26016, 26047, 26077, 26108, 26138, 26168, 26198, 26229, 26259, 26289,
+    26319, 26349, 26378, 26408, 26438, 26468, 26497, 26527, 26556, 26586, 26615, 26644, 26674, 26703, 26732, 26761,
+    26790, 26819, 26848, 26876, 26905, 26934, 26962, 26991, 27019, 27048, 27076, 27104, 27133, 27161, 27189, 27217,
+    27245, 27273, 27300, 27328, 27356, 27384, 27411, 27439, 27466, 27493, 27521, 27548, 27575, 27602, 27629, 27656,
+    27683, 27710, 27737, 27764, 27790, 27817, 27843, 27870, 27896, 27923, 27949, 27975, 28001, 28027, 28053, 28079,
+    28105, 28131, 28157, 28182, 28208, 28234, 28259, 28284, 28310, 28335, 28360, 28385, 28411, 28436, 28460, 28485,
+    28510, 28535, 28560, 28584, 28609, 28633, 28658, 28682, 28706, 28730, 28755, 28779, 28803, 28827, 28850, 28874,
+    28898, 28922, 28945, 28969, 28992, 29016, 29039, 29062, 29085, 29108, 29131, 29154, 29177, 29200, 29223, 29246,
+    29268, 29291, 29313, 29336, 29358, 29380, 29403, 29425, 29447, 29469, 29491, 29513, 29534, 29556, 29578, 29599,
+    29621, 29642, 29664, 29685, 29706, 29728, 29749, 29770, 29791, 29812, 29832, 29853, 29874, 29894, 29915, 29936,
+    29956, 29976, 29997, 30017, 30037, 30057, 30077, 30097, 30117, 30136, 30156, 30176, 30195, 30215, 30234, 30253,
+    30273, 30292, 30311, 30330, 30349, 30368, 30387, 30406, 30424, 30443, 30462, 30480, 30498, 30517, 30535, 30553,
+    30571, 30589, 30607, 30625, 30643, 30661, 30679, 30696, 30714, 30731, 30749, 30766, 30783, 30800, 30818, 30835,
+    30852, 30868, 30885, 30902, 30919, 30935, 30952, 30968, 30985, 31001, 31017, 31033, 31050, 31066, 31082, 31097,
+    31113, 31129, 31145, 31160, 31176, 31191, 31206, 31222, 31237, 31252, 31267, 31282, 31297, 31312, 31327, 31341,
+    31356, 31371, 31385, 31400, 31414, 31428, 31442, 31456, 31470, 31484, 31498, 31512, 31526, 31539, 31553, 31567,
+    31580, 31593, 31607, 31620, 31633, 31646, 31659, 31672, 31685, 31698, 31710, 31723, 31736, 31748, 31760, 31773,
+    31785, 31797, 31809, 31821, 31833, 31845, 31857, 31869, 31880, 31892, 31903, 31915, 31926, 31937, 31949, 31960,
+    31971, 31982, 31993, 32004, 32014, 32025, 32036, 32046, 32057, 32067, 32077, 32087, 32098, 32108, 32118, 32128,
+    32137, 32147, 32157, 32166, 32176, 32185, 32195, 32204, 32213, 32223, 32232, 32241, 32250, 32258, 32267, 32276,
+    32285, 32293, 32302, 32310, 32318, 32327, 32335, 32343, 32351, 32359, 32367, 32375, 32382, 32390, 32397, 32405,
+    32412, 32420, 32427, 32434, 32441, 32448, 32455, 32462, 32469, 32476, 32482, 32489, 32495, 32502, 32508, 32514,
+    32521, 32527, 32533, 32539, 32545, 32550, 32556, 32562, 32567, 32573, 32578, 32584, 32589, 32594, 32599, 32604,
+    32609, 32614, 32619, 32624, 32628, 32633, 32637, 32642, 32646, 32650, 32655, 32659, 32663, 32667, 32671, 32674,
+    32678, 32682, 32685, 32689, 32692, 32696, 32699, 32702, 32705, 32708, 32711, 32714, 32717, 32720, 32722, 32725,
+    32728, 32730, 32732, 32735, 32737, 32739, 32741, 32743, 32745, 32747, 32748, 32750, 32752, 32753, 32755, 32756,
+    32757, 32758, 32759, 32760, 32761, 32762, 32763, 32764, 32765, 32765, 32766, 32766, 32766, 32767, 32767, 32767,
+    32767
+};
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
 
 void initHw();
+void initCycleCounter();
+void resetIsrStats();
+void recordIsrStats(uint32_t entry, uint32_t latency);
 void initTimer();
+void initLdacTimer();
+void startSampleClock();
+void stopSampleClock();
+void setLdacMode(LDAC_MODE mode);
 void sendData(uint16_t Data);
 void sendDACsData(uint16_t DataA, uint16_t DataB);
 void setDacVoltage (DAC DAC_SEL, float voltage);    // DAC output voltage
+void setDacWord(DAC DAC_SEL, uint16_t D);
 void setOpampVoltageOut (DAC DAC_SEL, float voltage); // OPAMP output voltage
+void buildCalTable(DAC DAC_SEL);
+uint16_t calcDacCode(DAC DAC_SEL, int16_t voltage);
+int32_t calcPhaseIndex(float Phase);
+void buildSineLut(int16_t shape[], float Phase);
+void buildSquareLut(int16_t shape[], float Phase);
+void buildTriangleLut(int16_t shape[], float Phase);
+void buildSawtoothLut(int16_t shape[], float Phase);
+int16_t calcQuarterSine(uint32_t phase);
+int32_t calcQuarterSineInterpolated(uint32_t phase);
+int32_t calcShapeInterpolated(const int16_t shape[], uint32_t phase);
+void setChannelScale(DAC DAC_SEL, float Amplitude, float offset);
+void applyChannelUpdate(DAC DAC_SEL);
+void flushChannelUpdate(DAC DAC_SEL);
+void commitChannelUpdate(DAC DAC_SEL);
+int16_t* claimSpareShape(DAC DAC_SEL);
+void buildLut(DAC DAC_SEL, WAVEFORM waveform, float Amplitude, float offset, float Phase);
+uint16_t updateCrc16(uint16_t crc, uint8_t data);
+bool readUploadByte(uint8_t* data, uint16_t* crc);
+void drainUpload();
+void resampleShape(int16_t shape[], uint32_t length);
 void sinusoidalFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase); // sine wave function
 void squareFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase);     // square wave function
 void triangleFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase);   // triangle wave function
 void sawtoothFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase);   // sawtooth wave function
 uint16_t calcDACDataForOpampVoltage(DAC DAC_SEL, float voltage);
+uint32_t calcTuningWord(float Frequency);
+float calcActualFrequency(uint32_t tuningWord);
+void setFrequency(DAC DAC_SEL, float Frequency);
+void setSampleRate(float rate);
+float calcAutoSampleRate();
+void updateAutoSampleRate();
+int32_t calcVoltageA();
+uint16_t calcSampleA();
+uint16_t calcSampleB();
+void stepChannelA();
+void stepChannelB();
+void stepSweep(DAC DAC_SEL);
+void startSweep(DAC DAC_SEL, SWEEP_MODE mode);
+void stopSweep(DAC DAC_SEL);
+int32_t calcModulationSource();
+void setModulation(MODULATION mode, float depth);
+void renderSamples(uint16_t buffer[], uint16_t samples);
+void refillDmaBuffers();
+void setOutputMode(OUTPUT mode);
 void timer1Isr();
+void selectTimer1Isr();
+void installTimer1Isr();
+void streamIsr();
+void detectIsr();
+bool measureResponse(float frequency, uint32_t settlePeriods, uint32_t periods, DETECT_RESULT result[2]);
+uint16_t countGainPoints(GAIN_PLAN* plan);
+float calcGainPoint(GAIN_PLAN* plan, uint16_t index);
+void planGainPoint(float frequency, uint32_t* settlePeriods, uint32_t* periods);
+void resetMeasure(MEASURE* m, uint16_t low, uint16_t high);
+bool accumulatePairs(MEASURE m[2], uint32_t count);
+
+const LUT_BUILDER lutBuilders[] = {buildSineLut, buildSquareLut, buildTriangleLut, buildSawtoothLut};
+const WAVE_FUNCTION waveFunctions[] = {sinusoidalFunction, squareFunction, triangleFunction, sawtoothFunction};
+const char* waveNames[] = {"Sine", "Square", "Triangle", "Sawtooth", "Arbitrary"};
 
 
 // Initialize Hardware
@@ -112,7 +569,7 @@ void initHw()
     // Initialize SPI1 interface
     initSpi1(USE_SSI_FSS);
     setSpi1BaudRate(20e6, 40e6);
-    setSpi1Mode(1, 1);
+    setSpi1Mode(0, 0);          // SPH=0 pulses FSS between back-to-back words, one MCP4822 frame each
 
 
     //Enable clocks
@@ -125,6 +582,73 @@ void initHw()
     selectPinAnalogInput(AIN2_INPUTA);
     selectPinAnalogInput(AIN1_INPUTB);
 
+    initCycleCounter();
+
+    // Timer1 handlers are swapped at run time (see selectTimer1Isr)
+    relocateNvicVectorTable();
+}
+
+// Free-running CPU cycle counter used for ISR and benchmark timing
+void initCycleCounter()
+{
+    NVIC_DBG_INT_R |= NVIC_DBG_INT_TRCENA;
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;
+    resetIsrStats();
+}
+
+void resetIsrStats()
+{
+    isrStats.count = 0;
+    isrStats.minCycles = 0xFFFFFFFF;
+    isrStats.maxCycles = 0;
+    isrStats.totalCycles = 0;
+    isrStats.minLatency = 0xFFFFFFFF;
+    isrStats.maxLatency = 0;
+    isrStats.missed = 0;
+    isrStats.overruns = 0;
+}
+
+// Record one timer1Isr run (called last in the ISR)
+// In uDMA mode the ISR runs once per half buffer, so the expected interval is DMA_SAMPLES periods
+void recordIsrStats(uint32_t entry, uint32_t latency)
+{
+    uint32_t cycles = DWT_CYCCNT_R - entry;
+    uint32_t period = TIMER1_TAILR_R + 1;
+    uint32_t interval;
+
+    if (outputMode == OUT_DMA)
+    {
+        period *= DMA_SAMPLES;
+    }
+
+    if (isrStats.count > 0)
+    {
+        interval = entry - isrStats.lastEntry;
+        if (interval > period + period / 2)
+        {
+            isrStats.missed += (interval + period / 2) / period - 1;
+        }
+    }
+    isrStats.lastEntry = entry;
+    isrStats.count++;
+
+    isrStats.totalCycles += cycles;
+    if (cycles < isrStats.minCycles)
+        isrStats.minCycles = cycles;
+    if (cycles > isrStats.maxCycles)
+        isrStats.maxCycles = cycles;
+
+    // The Timer1 count only gives the entry latency when every timeout interrupts
+    if (outputMode != OUT_DMA)
+    {
+        if (latency < isrStats.minLatency)
+            isrStats.minLatency = latency;
+        if (latency > isrStats.maxLatency)
+            isrStats.maxLatency = latency;
+        if (latency + cycles > period)
+            isrStats.overruns++;
+    }
 }
 
 void initTimer()
@@ -137,1067 +661,2869 @@ void initTimer()
     TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer before reconfiguring
     TIMER1_CFG_R = TIMER_CFG_32_BIT_TIMER;           // configure as 32-bit timer (A+B)
     TIMER1_TAMR_R = TIMER_TAMR_TAMR_PERIOD;          // configure for periodic mode (count down)
-    TIMER1_TAILR_R = 488;                            // set load value
+    TIMER1_TAILR_R = TIMER1_LOAD;                    // set load value
     TIMER1_IMR_R = TIMER_IMR_TATOIM;                 // turn-on interrupts for timeout in timer module
-    TIMER1_CTL_R |= TIMER_CTL_TAEN;                  // turn-on timer
+    selectTimer1Isr();
     NVIC_EN0_R |= 1 << (INT_TIMER1A-16);
+
+    initLdacTimer();
+    setLdacMode(ldacMode);
+    startSampleClock();
+
+    // Timer1A timeouts can also pace uDMA transfers into SSI1 (see setOutputMode)
+    initUdma();
+    selectUdmaChannelSource(UDMA_CH_TIMER1A, UDMA_ENC_TIMER1A);
+    lastWordA = calcDACDataForOpampVoltage(DACA, 0);
+    lastWordB = calcDACDataForOpampVoltage(DACB, 0);
 }
 
-void timer1Isr()  // call lut function
+// Wide Timer 3A generates the LDAC strobe on PD2, phase-locked to Timer1
+void initLdacTimer()
+{
+    // Enable clocks (Timer0 holds the GPTM synchronization register)
+    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R3;
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R0;
+    _delay_cycles(3);
+
+    WTIMER3_CTL_R &= ~TIMER_CTL_TAEN;                // turn-off timer before reconfiguring
+    WTIMER3_CFG_R = TIMER_CFG_16_BIT;                // configure as 32-bit timer (A only)
+    WTIMER3_TAMR_R = TIMER_TAMR_TAAMS | TIMER_TAMR_TAMR_PERIOD;
+                                                     // configure for PWM mode (count down)
+    WTIMER3_TAILR_R = TIMER1_LOAD;                   // same period as the sample clock
+    WTIMER3_TAMATCHR_R = LDAC_PULSE;                 // output goes low at the match, high again at reload
+    WTIMER3_CTL_R |= TIMER_CTL_TAEN;                 // keep strobing while Timer1 is paused so DC writes still latch
+}
+
+// Start Timer1 and restart the LDAC timer in phase with it
+void startSampleClock()
 {
+    resetIsrStats();                                 // the gap while stopped is not a missed period
+    TIMER1_CTL_R |= TIMER_CTL_TAEN;                  // turn-on timer
+    TIMER0_SYNC_R = TIMER_SYNC_SYNCT1_TA | TIMER_SYNC_SYNCWT3_TA;
+                                                     // reload both counters on the same cycle
+}
 
+void stopSampleClock()
+{
+    TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer
+}
 
-    if(differential == ON)
+// Select how LDAC transfers the MCP4822 input registers to the outputs
+void setLdacMode(LDAC_MODE mode)
+{
+    ldacMode = mode;
+    if (mode == LDAC_TIMER)
     {
-        if (N_cycles_A == -1)
-        {
+        setPinAuxFunction(LDAC, GPIO_PCTL_PD2_WT3CCP0);
+    }
+    else
+    {
+        setPinAuxFunction(LDAC, 0);
+        // The uDMA path cannot pulse a GPIO per word, so it latches on CS instead
+        setPinValue(LDAC, !(mode == LDAC_CS || outputMode == OUT_DMA));
+    }
+}
 
-            sendData( LUT_DATA_A [(uint16_t)countA]);
-            sendData( LUT_DATA_C [(uint16_t)countA]);
-            countA = (countA + Step_Size_A);
-            countA = fmod(countA, LUT_SIZE);
-        }
-        else if (N_cycles_A > 0)
+void timer1Isr()  // call lut function
+{
+    uint32_t entry = DWT_CYCCNT_R;
+    uint32_t latency = TIMER1_TAILR_R - TIMER1_TAV_R;  // Timer1 counts down from the load value
+
+    if (outputMode == OUT_DMA)
+    {
+        // Timeouts only request uDMA transfers, this runs once per finished half buffer
+        if (isUdmaChannelInterrupt(UDMA_CH_TIMER1A))
         {
-            sendData( LUT_DATA_A [(uint16_t)countA]);
-            sendData( LUT_DATA_C [(uint16_t)countA]);
-            countA = (countA + Step_Size_A);
-            if (countA > LUT_SIZE)
-            {
-                // Finished 1 Period
-                countA = fmod(countA, LUT_SIZE);
-                N_cycles_A--;
-            }
+            clearUdmaChannelInterrupt(UDMA_CH_TIMER1A);
+            refillDmaBuffers();
         }
     }
-    else
+    else if (pipeline == P_ON)
+    {
+        uint16_t words[2];
+
+        renderSamples(words, 1);
+        sendDACsData(words[0], words[1]);
+    }
+    else if(differential == ON)
     {
-        if (N_cycles_A == -1)
+        if (N_cycles_A == -1 || N_cycles_A > 0)
         {
+            int32_t v = calcVoltageA();
 
-            sendData( LUT_DATA_A [(uint16_t)countA]);
-            countA = (countA + Step_Size_A);
-            countA = fmod(countA, LUT_SIZE);
+            sendData( calcDacCode(DACA, v));
+            sendData( calcDacCode(DACB, -v));
+            stepChannelA();
         }
-        else if (N_cycles_A > 0)
+    }
+    else
+    {
+        if (N_cycles_A == -1 || N_cycles_A > 0)
         {
-            sendData( LUT_DATA_A [(uint16_t)countA]);
-            countA = (countA + Step_Size_A);
-            if (countA > LUT_SIZE)
-            {
-                // Finished 1 Period
-                countA = fmod(countA, LUT_SIZE);
-                N_cycles_A--;
-            }
+            sendData( calcSampleA());
+            stepChannelA();
         }
 
-        if (N_cycles_B == -1)
-        {
-
-            sendData( LUT_DATA_B [(uint16_t)countB]);
-            countB = (countB + Step_Size_B);
-            countB = fmod(countB, LUT_SIZE);
-        }
-        else if (N_cycles_B > 0)
+        if (N_cycles_B == -1 || N_cycles_B > 0)
         {
-            sendData( LUT_DATA_B [(uint16_t)countB]);
-            countB = (countB + Step_Size_B);
-            if (countB > LUT_SIZE)
-            {
-                // Finished 1 Period
-                countB = fmod(countB, LUT_SIZE);
-                N_cycles_B--;
-            }
+            sendData( calcSampleB());
+            stepChannelB();
         }
     }
 
     TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+
+    recordIsrStats(entry, latency);
 }
 
-void sinusoidalFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+// Channel output in Q12 volts for a constant table mode, the mode checks fold away and
+// leave one table read; the quadrant fold and the clamp are the remaining data-dependent steps
+#define CALC_TABLE_VOLTAGE(v, mode, shape, phase, phaseOffset, amplitude, offset)  \
+{                                                                                   \
+    int32_t s;                                                                      \
+                                                                                    \
+    if ((mode) == TABLE_QUARTER)                                                    \
+        s = calcQuarterSine((phase) + (phaseOffset));                               \
+    else if ((mode) == TABLE_QUARTER_INTERP)                                        \
+        s = calcQuarterSineInterpolated((phase) + (phaseOffset));                   \
+    else if ((mode) == TABLE_SHAPE_INTERP)                                          \
+        s = calcShapeInterpolated(shape, phase);                                    \
+    else                                                                            \
+        s = (shape)[(phase) >> PHASE_SHIFT];                                        \
+    v = (offset) + ((s * (amplitude)) >> 15);                                       \
+    if (v > VOLT_MAX_Q12) v = VOLT_MAX_Q12;                                         \
+    if (v < -VOLT_MAX_Q12) v = -VOLT_MAX_Q12;                                       \
+}
+
+// Pipelined Timer1 handlers specialized for one channel configuration, the checks timer1Isr
+// makes on every sample become constants and fold away. useA/useB: channel running,
+// diff: differential pair from channel A, burstA/burstB: count periods (else continuous),
+// modeA/modeB: table read (TABLE_*). Sweeping and modulated channels are bursts and read
+// through calcSampleA/B (TABLE_GENERAL), stepChannelA/B do the rest of their work
+#define DEFINE_SAMPLE_ISR(name, useA, useB, diff, burstA, burstB, modeA, modeB)     \
+void name()                                                                         \
+{                                                                                   \
+    uint32_t entry = DWT_CYCCNT_R;                                                  \
+    uint32_t latency = TIMER1_TAILR_R - TIMER1_TAV_R;                               \
+    int32_t v;                                                                      \
+                                                                                    \
+    if (diff)                                                                       \
+    {                                                                               \
+        if ((modeA) == TABLE_GENERAL)                                               \
+            v = calcVoltageA();                                                     \
+        else                                                                        \
+            CALC_TABLE_VOLTAGE(v, modeA, shapeA, phaseA, phaseOffsetA, amplitudeA, offsetA) \
+        lastWordA = calcDacCode(DACA, v);                                           \
+        lastWordB = calcDacCode(DACB, -v);                                          \
+    }                                                                               \
+    else                                                                            \
+    {                                                                               \
+        if (useA && (modeA) == TABLE_GENERAL)                                       \
+            lastWordA = calcSampleA();                                              \
+        else if (useA)                                                              \
+        {                                                                           \
+            CALC_TABLE_VOLTAGE(v, modeA, shapeA, phaseA, phaseOffsetA, amplitudeA, offsetA) \
+            lastWordA = calcDacCode(DACA, v);                                       \
+        }                                                                           \
+        if (useB && (modeB) == TABLE_GENERAL)                                       \
+            lastWordB = calcSampleB();                                              \
+        else if (useB)                                                              \
+        {                                                                           \
+            CALC_TABLE_VOLTAGE(v, modeB, shapeB, phaseB, phaseOffsetB, amplitudeB, offsetB) \
+            lastWordB = calcDacCode(DACB, v);                                       \
+        }                                                                           \
+    }                                                                               \
+    if (useA || useB || diff)                                                       \
+        sendDACsData(lastWordA, lastWordB);                                         \
+                                                                                    \
+    if (useA || diff)                                                               \
+    {                                                                               \
+        if (burstA)                                                                 \
+            stepChannelA();                                                         \
+        else                                                                        \
+        {                                                                           \
+            uint32_t phase = phaseA;                                                \
+            phaseA += tuningWordA;                                                  \
+            if (phaseA < phase && channelUpdates[DACA].pending)                     \
+                applyChannelUpdate(DACA);                                           \
+        }                                                                           \
+    }                                                                               \
+    if (useB && !diff)                                                              \
+    {                                                                               \
+        if (burstB)                                                                 \
+            stepChannelB();                                                         \
+        else                                                                        \
+        {                                                                           \
+            uint32_t phase = phaseB;                                                \
+            phaseB += tuningWordB;                                                  \
+            if (phaseB < phase && channelUpdates[DACB].pending)                     \
+                applyChannelUpdate(DACB);                                           \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;                                              \
+    recordIsrStats(entry, latency);                                                 \
+}
+
+//                name                   useA   useB   diff   burstA burstB modeA                 modeB
+DEFINE_SAMPLE_ISR(idleIsr,               false, false, false, false, false, TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleABurstIsr,       true,  false, false, true,  false, TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleBBurstIsr,       false, true,  false, false, true,  TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(dualABurstIsr,         true,  true,  false, true,  false, TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(dualBBurstIsr,         true,  true,  false, false, true,  TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(dualBurstIsr,          true,  true,  false, true,  true,  TABLE_GENERAL,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(differentialBurstIsr,  false, false, true,  true,  false, TABLE_GENERAL,        TABLE_GENERAL)
+
+// Continuous channels, one handler per table mode (digits: mode of A, then of B)
+DEFINE_SAMPLE_ISR(singleA0Isr,           true,  false, false, false, false, TABLE_SHAPE,          TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleA1Isr,           true,  false, false, false, false, TABLE_QUARTER,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleA2Isr,           true,  false, false, false, false, TABLE_SHAPE_INTERP,   TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleA3Isr,           true,  false, false, false, false, TABLE_QUARTER_INTERP, TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(singleB0Isr,           false, true,  false, false, false, TABLE_GENERAL,        TABLE_SHAPE)
+DEFINE_SAMPLE_ISR(singleB1Isr,           false, true,  false, false, false, TABLE_GENERAL,        TABLE_QUARTER)
+DEFINE_SAMPLE_ISR(singleB2Isr,           false, true,  false, false, false, TABLE_GENERAL,        TABLE_SHAPE_INTERP)
+DEFINE_SAMPLE_ISR(singleB3Isr,           false, true,  false, false, false, TABLE_GENERAL,        TABLE_QUARTER_INTERP)
+DEFINE_SAMPLE_ISR(dual00Isr,             true,  true,  false, false, false, TABLE_SHAPE,          TABLE_SHAPE)
+DEFINE_SAMPLE_ISR(dual01Isr,             true,  true,  false, false, false, TABLE_SHAPE,          TABLE_QUARTER)
+DEFINE_SAMPLE_ISR(dual02Isr,             true,  true,  false, false, false, TABLE_SHAPE,          TABLE_SHAPE_INTERP)
+DEFINE_SAMPLE_ISR(dual03Isr,             true,  true,  false, false, false, TABLE_SHAPE,          TABLE_QUARTER_INTERP)
+DEFINE_SAMPLE_ISR(dual10Isr,             true,  true,  false, false, false, TABLE_QUARTER,        TABLE_SHAPE)
+DEFINE_SAMPLE_ISR(dual11Isr,             true,  true,  false, false, false, TABLE_QUARTER,        TABLE_QUARTER)
+DEFINE_SAMPLE_ISR(dual12Isr,             true,  true,  false, false, false, TABLE_QUARTER,        TABLE_SHAPE_INTERP)
+DEFINE_SAMPLE_ISR(dual13Isr,             true,  true,  false, false, false, TABLE_QUARTER,        TABLE_QUARTER_INTERP)
+DEFINE_SAMPLE_ISR(dual20Isr,             true,  true,  false, false, false, TABLE_SHAPE_INTERP,   TABLE_SHAPE)
+DEFINE_SAMPLE_ISR(dual21Isr,             true,  true,  false, false, false, TABLE_SHAPE_INTERP,   TABLE_QUARTER)
+DEFINE_SAMPLE_ISR(dual22Isr,             true,  true,  false, false, false, TABLE_SHAPE_INTERP,   TABLE_SHAPE_INTERP)
+DEFINE_SAMPLE_ISR(dual23Isr,             true,  true,  false, false, false, TABLE_SHAPE_INTERP,   TABLE_QUARTER_INTERP)
+DEFINE_SAMPLE_ISR(dual30Isr,             true,  true,  false, false, false, TABLE_QUARTER_INTERP, TABLE_SHAPE)
+DEFINE_SAMPLE_ISR(dual31Isr,             true,  true,  false, false, false, TABLE_QUARTER_INTERP, TABLE_QUARTER)
+DEFINE_SAMPLE_ISR(dual32Isr,             true,  true,  false, false, false, TABLE_QUARTER_INTERP, TABLE_SHAPE_INTERP)
+DEFINE_SAMPLE_ISR(dual33Isr,             true,  true,  false, false, false, TABLE_QUARTER_INTERP, TABLE_QUARTER_INTERP)
+DEFINE_SAMPLE_ISR(differential0Isr,      false, false, true,  false, false, TABLE_SHAPE,          TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(differential1Isr,      false, false, true,  false, false, TABLE_QUARTER,        TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(differential2Isr,      false, false, true,  false, false, TABLE_SHAPE_INTERP,   TABLE_GENERAL)
+DEFINE_SAMPLE_ISR(differential3Isr,      false, false, true,  false, false, TABLE_QUARTER_INTERP, TABLE_GENERAL)
+
+// Indexed by channel state: 0 idle, 1 continuous, 2 burst. Continuous channels are
+// NULL here and come from continuousIsrs by table mode
+void (* const sampleIsrs[3][3])(void) =
 {
-    uint16_t i;
-    float sinVoltage;
+    {idleIsr,         NULL,            singleBBurstIsr},
+    {NULL,            NULL,            dualBBurstIsr},
+    {singleABurstIsr, dualABurstIsr,   dualBurstIsr}
+};
+void (* const differentialIsrs[3])(void) = {idleIsr, NULL, differentialBurstIsr};
+
+// Indexed by 0 for an idle channel, else 1 + its table mode
+void (* const continuousIsrs[5][5])(void) =
+{
+    {idleIsr,     singleB0Isr, singleB1Isr, singleB2Isr, singleB3Isr},
+    {singleA0Isr, dual00Isr,   dual01Isr,   dual02Isr,   dual03Isr},
+    {singleA1Isr, dual10Isr,   dual11Isr,   dual12Isr,   dual13Isr},
+    {singleA2Isr, dual20Isr,   dual21Isr,   dual22Isr,   dual23Isr},
+    {singleA3Isr, dual30Isr,   dual31Isr,   dual32Isr,   dual33Isr}
+};
+void (* const differentialModeIsrs[4])(void) = {differential0Isr, differential1Isr, differential2Isr, differential3Isr};
+
+// Install the Timer1 handler for the current configuration. uDMA and blocking output,
+// or specialized handlers turned off, use the general timer1Isr. Call after changing
+// the output mode, pipeline, differential mode, a cycle count, a sweep, modulation or
+// interpolation, then the sample rate follows in auto mode.
+// A sweeping or modulated channel uses the burst handler, stepChannelA/B do the work
+void selectTimer1Isr()
+{
+    installTimer1Isr();
+    updateAutoSampleRate();
+}
 
-    for (i = 0; i < LUT_SIZE; i++)
-    {
-        sinVoltage = Amplitude * sin((( (float)i * 2.0 * M_PI )/ LUT_SIZE) + (Phase * M_PI)) + offset;//+  Phase ) + offset;
+// Picks and installs the handler only, safe from the output path (a burst or sweep ending,
+// a period-boundary update switching between the quarter-wave and shape tables), where
+// the sample rate must not be reprogrammed
+void installTimer1Isr()
+{
+    void (*isr)(void) = timer1Isr;
+    uint8_t a = (N_cycles_A == 0) ? 0 : ((N_cycles_A > 0 || sweeps[DACA].mode != SWEEP_OFF || modulation != MOD_OFF) ? 2 : 1);
+    uint8_t b = (N_cycles_B == 0) ? 0 : ((N_cycles_B > 0 || sweeps[DACB].mode != SWEEP_OFF) ? 2 : 1);
+    uint8_t modeA = (quarterSineA ? TABLE_QUARTER : 0) | (interpolateA ? TABLE_SHAPE_INTERP : 0);
+    uint8_t modeB = (quarterSineB ? TABLE_QUARTER : 0) | (interpolateB ? TABLE_SHAPE_INTERP : 0);
 
-        if (DAC_SEL == DACA)
-        {
-            Step_Size_A = Frequency/REF_FREQUENCY;
-            LUT_DATA_A [i] = calcDACDataForOpampVoltage(DACA, sinVoltage);
-            LUT_DATA_C [i] = calcDACDataForOpampVoltage(DACB, -sinVoltage);
-        }
-        else if (DAC_SEL == DACB)
-        {
-            Step_Size_B = Frequency/REF_FREQUENCY;
-            LUT_DATA_B [i] =   calcDACDataForOpampVoltage(DACB, sinVoltage);
-        }
+    if (specializedIsr && outputMode == OUT_ISR && pipeline == P_ON)
+    {
+        if (differential == ON)
+            isr = (a == 1) ? differentialModeIsrs[modeA] : differentialIsrs[a];
+        else if (a < 2 && b < 2)
+            isr = continuousIsrs[a ? modeA + 1 : 0][b ? modeB + 1 : 0];
+        else
+            isr = sampleIsrs[a][b];
+    }
+    if (streaming)
+    {
+        isr = streamIsr;
+    }
+    if (detectState != DETECT_OFF)
+    {
+        isr = detectIsr;
     }
+    modulationStepsB = (N_cycles_B == 0) || (differential == ON);
+    setNvicVector(INT_TIMER1A, isr);
 }
 
-void squareFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+// Timer1 handler while streaming: the stream channel plays ring samples, holding each one
+// until the stream accumulator carries, the other channel holds its last word
+void streamIsr()
 {
-    uint16_t i;
-    float sinVoltage;
+    uint32_t entry = DWT_CYCCNT_R;
+    uint32_t latency = TIMER1_TAILR_R - TIMER1_TAV_R;
+    uint32_t phase = streamPhase;
+    int32_t v;
+
+    streamPhase += streamTuningWord;
+    if (streamPhase < phase)
+        readStream(&streamSample);                   // counts an underrun and keeps the sample when empty
+    v = streamOffset + ((streamSample * streamAmplitude) >> 15);
+    if (v > VOLT_MAX_Q12) v = VOLT_MAX_Q12;
+    if (v < -VOLT_MAX_Q12) v = -VOLT_MAX_Q12;
+
+    if (streamDac == DACA)
+        lastWordA = calcDacCode(DACA, v);
+    else
+        lastWordB = calcDacCode(DACB, v);
+    sendDACsData(lastWordA, lastWordB);
 
-    for (i = 0; i < LUT_SIZE; i++)
-    {
-        sinVoltage = Amplitude * sin((( (float)i * 2.0 * M_PI )/ LUT_SIZE) + (Phase * M_PI)) + offset;//+  Phase ) + offset;
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+    recordIsrStats(entry, latency);
+}
 
-        if (sinVoltage <= 0)
-        {
-            sinVoltage = -1 * Amplitude + offset;
-        }
-        else
+// Timer1 handler while measuring: plays channel A like the singleA handlers and correlates both
+// inputs against the DDS phase. Timer1's output trigger starts ADC0 and ADC1 together at
+// every timeout, so each run reads the pair the previous timeout started and pairs it
+// with the phase saved then. The DAC pipeline adds a fixed delay, the same on both inputs
+void detectIsr()
+{
+    uint32_t entry = DWT_CYCCNT_R;
+    uint32_t latency = TIMER1_TAILR_R - TIMER1_TAV_R;
+    uint32_t phase = phaseA;
+    ADC_PAIR pair;
+    int32_t x0;
+    int32_t x1;
+    int32_t c;
+    int32_t s;
+
+    if (readAdcPair(&pair))
+    {
+        x0 = (int32_t)pair.in1 - 2048;
+        x1 = (int32_t)pair.in2 - 2048;
+        if (detectState == DETECT_INTEGRATE)
         {
-            sinVoltage = 1 * Amplitude + offset;
+            c = calcQuarterSine(detectPhase + 0x40000000);
+            s = calcQuarterSine(detectPhase);
+            detectI[0] += x0 * c;
+            detectQ[0] += x0 * s;
+            detectI[1] += x1 * c;
+            detectQ[1] += x1 * s;
+            detectCount++;
         }
+    }
+    detectPhase = phase;
 
-        if (DAC_SEL == DACA)
-        {
-            Step_Size_A = Frequency/REF_FREQUENCY;
-            LUT_DATA_A [i] = calcDACDataForOpampVoltage(DACA, sinVoltage);
-            LUT_DATA_C [i] = calcDACDataForOpampVoltage(DACB, -sinVoltage);
+    lastWordA = calcSampleA();
+    sendDACsData(lastWordA, lastWordB);
+    stepChannelA();
 
-        }
-        else if (DAC_SEL == DACB)
-        {
-            Step_Size_B = Frequency/REF_FREQUENCY;
-            LUT_DATA_B [i] =  calcDACDataForOpampVoltage(DACB, sinVoltage);
-        }
+    // Settling and integration both run over whole periods (accumulator wraps)
+    if (phaseA < phase)
+    {
+        if (detectState == DETECT_SETTLE && --detectSettle == 0)
+            detectState = DETECT_INTEGRATE;
+        else if (detectState == DETECT_INTEGRATE && --detectPeriods == 0)
+            detectState = DETECT_DONE;
     }
+
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+    recordIsrStats(entry, latency);
 }
 
-void triangleFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+// Drives channel A at frequency and measures the component at that frequency on both inputs:
+// settlePeriods whole periods are skipped, then the inputs are correlated with the DDS cosine
+// and sine over periods whole periods. For x = a*sin(wt + p), I = n*a/2*sin(p), Q = n*a/2*cos(p).
+// Needs per-sample ISR output and the sample clock running; returns false if the measurement does not finish
+bool measureResponse(float frequency, uint32_t settlePeriods, uint32_t periods, DETECT_RESULT result[2])
 {
-    uint16_t i;
-    float sinVoltage;
-
-    for (i = 0; i < LUT_SIZE; i++)
+    uint32_t start;
+    uint32_t timeout;
+    float duration;
+    float limit;
+    uint8_t i;
+
+    if (frequency <= 0 || periods == 0 || outputMode != OUT_ISR || !(TIMER1_CTL_R & TIMER_CTL_TAEN))
+        return false;
+    setFrequency(DACA, frequency);
+    duration = (settlePeriods + periods + 1) / calcActualFrequency(tuningWordA);
+    limit = 2 * duration * SYSTEM_CLOCK + SYSTEM_CLOCK / 10;
+    timeout = (limit < 4294967296.0f) ? (uint32_t)limit : 0xFFFFFFFF;  // the cycle counter spans 107 s
+
+    for (i = 0; i < 2; i++)
+    {
+        detectI[i] = 0;
+        detectQ[i] = 0;
+    }
+    detectCount = 0;
+    detectSettle = settlePeriods + 1;                // the current, partial period is never used
+    detectPeriods = periods;
+    setAdcPairTimerTrigger(true, false);
+    detectState = DETECT_SETTLE;
+    selectTimer1Isr();
+    TIMER1_CTL_R |= TIMER_CTL_TAOTE;                 // sample clock starts the conversions
+
+    start = DWT_CYCCNT_R;
+    while (detectState != DETECT_DONE && (DWT_CYCCNT_R - start) < timeout);
+
+    TIMER1_CTL_R &= ~TIMER_CTL_TAOTE;
+    setAdcPairTimerTrigger(false, false);
+    if (detectState != DETECT_DONE || detectCount == 0)
     {
-        sinVoltage = (2/M_PI) * Amplitude * asin (sin((((float)i * 2.0 * M_PI )/ LUT_SIZE) + (Phase * M_PI))) + offset;//+  Phase ) + offset;
+        detectState = DETECT_OFF;
+        selectTimer1Isr();
+        return false;
+    }
+    detectState = DETECT_OFF;
+    selectTimer1Isr();
 
-        if (DAC_SEL == DACA)
-        {
-            Step_Size_A = Frequency/REF_FREQUENCY;
-            LUT_DATA_A [i] = calcDACDataForOpampVoltage(DACA, sinVoltage);
-            LUT_DATA_C [i] = calcDACDataForOpampVoltage(DACB, -sinVoltage);
+    for (i = 0; i < 2; i++)
+    {
+        float I = (float)detectI[i] / 32767;
+        float Q = (float)detectQ[i] / 32767;
 
-        }
-        else if (DAC_SEL == DACB)
-        {
-            Step_Size_B = Frequency/REF_FREQUENCY;
-            LUT_DATA_B [i] =  calcDACDataForOpampVoltage(DACB, sinVoltage);
-        }
+        result[i].amplitude = 2 * sqrtf(I * I + Q * Q) / detectCount * ADC_FULL_SCALE / 4096;
+        result[i].phase = atan2f(I, Q) * 180 / PI_F;
     }
+    return true;
 }
 
-void sawtoothFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+// Number of points in a gain sweep: linear sweeps take the density as the count, log sweeps
+// cover every decade with at least density points; both include the start and stop
+uint16_t countGainPoints(GAIN_PLAN* plan)
 {
-    uint16_t i;
-    float sinVoltage;
+    float points = plan->density;
+
+    if (plan->log)
+        points = ceilf(fabsf(log10f(plan->stop / plan->start)) * plan->density) + 1;
+    if (points < 2)
+        points = 2;
+    if (points > GAIN_MAX_POINTS)
+        points = GAIN_MAX_POINTS;
+    return (uint16_t)points;
+}
 
-    for (i = 0; i < LUT_SIZE; i++)
-    {
-        sinVoltage = (2/M_PI) * Amplitude * atan (tan((((float)i * M_PI )/ LUT_SIZE) + (Phase * M_PI))) + offset;//+  Phase ) + offset;
+// Frequency of a point in a gain sweep, evenly spaced in log or linear frequency
+float calcGainPoint(GAIN_PLAN* plan, uint16_t index)
+{
+    float fraction = (float)index / (plan->points - 1);
 
-        if (DAC_SEL == DACA)
-        {
-            Step_Size_A = Frequency/REF_FREQUENCY;
-            LUT_DATA_A [i] = calcDACDataForOpampVoltage(DACA, sinVoltage);
-            LUT_DATA_C [i] = calcDACDataForOpampVoltage(DACB, -sinVoltage);
-        }
-        else if (DAC_SEL == DACB)
+    if (plan->log)
+        return plan->start * powf(plan->stop / plan->start, fraction);
+    return plan->start + (plan->stop - plan->start) * fraction;
+}
+
+// Settling and integration lengths for a point, in whole periods: the fewest that meet the
+// settling time and the sample count, so high frequencies finish in a fraction of a second
+// and low frequencies are not held longer than a couple of periods
+void planGainPoint(float frequency, uint32_t* settlePeriods, uint32_t* periods)
+{
+    float settle = ceilf(GAIN_SETTLE_TIME * frequency);
+    float integrate = ceilf(GAIN_MIN_SAMPLES * frequency / sampleRate);
+
+    *settlePeriods = (settle > GAIN_SETTLE_PERIODS) ? (uint32_t)settle : GAIN_SETTLE_PERIODS;
+    *periods = (integrate > GAIN_MIN_PERIODS) ? (uint32_t)integrate : GAIN_MIN_PERIODS;
+}
+
+// Clear the accumulators of one input, rising crossings between low and high are counted
+void resetMeasure(MEASURE* m, uint16_t low, uint16_t high)
+{
+    m->sum = 0;
+    m->sumSquares = 0;
+    m->min = 0xFFFF;
+    m->max = 0;
+    m->low = low;
+    m->high = high;
+    m->armed = false;
+    m->crossings = 0;
+    m->first = 0;
+    m->last = 0;
+}
+
+// Streams count IN1/IN2 pairs at the capture rate into the accumulators of both inputs,
+// false if a key press or a FIFO overflow ended it early
+bool accumulatePairs(MEASURE m[2], uint32_t count)
+{
+    ADC_PAIR pair;
+    uint16_t x[2];
+    uint32_t n = 0;
+    uint8_t i;
+
+    startAdcPairClock();
+    while (n < count && !isAdcPairOverflow() && !kbhitUart0())
+    {
+        if (!readAdcPair(&pair))
+            continue;
+        x[0] = pair.in1;
+        x[1] = pair.in2;
+        for (i = 0; i < 2; i++)
         {
-            Step_Size_B = Frequency/REF_FREQUENCY;
-            LUT_DATA_B [i] =  calcDACDataForOpampVoltage(DACB, sinVoltage);
+            m[i].sum += x[i];
+            m[i].sumSquares += (uint32_t)x[i] * x[i];
+            if (x[i] < m[i].min)
+                m[i].min = x[i];
+            if (x[i] > m[i].max)
+                m[i].max = x[i];
+            if (x[i] < m[i].low)
+                m[i].armed = true;
+            else if (m[i].armed && x[i] > m[i].high)
+            {
+                m[i].armed = false;
+                if (m[i].crossings++ == 0)
+                    m[i].first = n;
+                m[i].last = n;
+            }
         }
+        n++;
     }
+    stopCapture();
+    return n == count;
 }
 
-void sendData(uint16_t Data)
+// Returns the channel A output for the current phase, shape * amplitude + offset in Q12 volts
+// Differential mode sends -v through DAC B's calibration, so no inverted table is stored
+int32_t calcVoltageA()
 {
-    _delay_cycles(2);       // 25ns * 2 = 50ns (min 40ns) Before CS Fall
-    writeSpi1Data(Data);
-    readSpi1Data();
+    int32_t shape;
+    int32_t v;
+    uint32_t phase = phaseA;
 
-    _delay_cycles(2);       // 25ns * 2 = 50ns (min 40ns)
-    setPinValue(LDAC, 0);
+    if (modulation == MOD_PM)
+        phase += (int32_t)(((int64_t)modulationScale * calcModulationSource()) >> 15);
 
-    _delay_cycles(5);       // 25ns * 5 = 125ns (min 100ns)
-    setPinValue(LDAC, 1);
+    if (quarterSineA)
+        shape = interpolateA ? calcQuarterSineInterpolated(phase + phaseOffsetA) : calcQuarterSine(phase + phaseOffsetA);
+    else
+        shape = interpolateA ? calcShapeInterpolated(shapeA, phase) : shapeA[phase >> PHASE_SHIFT];
+    v = (shape * amplitudeA) >> 15;
+    if (modulation == MOD_AM)
+        v += (((v * modulationScale) >> 15) * calcModulationSource()) >> 15;
+    v += offsetA;
+
+    if (v > VOLT_MAX_Q12) v = VOLT_MAX_Q12;
+    if (v < -VOLT_MAX_Q12) v = -VOLT_MAX_Q12;
+    return v;
 }
 
-void setDacVoltage (DAC DAC_SEL, float voltage)
+// Returns channel B's normalized shape (Q15) at its current phase, the modulation source
+// for channel A. Channel B's amplitude and offset only affect its own output
+int32_t calcModulationSource()
 {
+    if (quarterSineB)
+        return calcQuarterSine(phaseB + phaseOffsetB);
+    return shapeB[phaseB >> PHASE_SHIFT];
+}
 
-    int16_t R = 0;
-    uint16_t D = 0;
-    uint16_t DAC = 0;
-    char str[100];
+// Sets the modulation of channel A by channel B and converts the depth to its per-sample
+// form. FM deviation is limited to the carrier frequency so the accumulator never runs
+// backward; stepChannelA holds the same limit per sample as the carrier changes later
+void setModulation(MODULATION mode, float depth)
+{
+    float scale = 0;
 
-    if (voltage < 0 )
+    if (mode == MOD_AM)
     {
-        voltage = 0;
+        if (depth > 1) depth = 1;
+        scale = depth * 32767;
     }
-    if (voltage > 2.048 )
+    else if (mode == MOD_FM)
     {
-        voltage = 2.048;
+        if (depth > frequencyA) depth = frequencyA;
+        scale = calcTuningWord(depth);
     }
-
-    if (DAC_SEL == DACA)
+    else if (mode == MOD_PM)
     {
-        //voltage = voltage + DAC_A_OFFSET;
-        R = (2005.1 * voltage) - 7.7708;
-        if (R < 0) R = 0;
-        if (R > 4095) R = 4095;
-        DAC = 0x3 << 12;
-        D = (DAC) | (R & 0x0FFF);
-
+        if (depth > 1) depth = 1;
+        scale = depth * 2147483647.0f;
     }
-    else if (DAC_SEL == DACB)
-    {
-        //voltage = voltage + DAC_B_OFFSET;
-        R = (2005.1 * voltage) - 7.7708;
-        DAC = 0xB << 12;
-        D = (DAC) | (R & 0x0FFF);
+    if (depth < 0) scale = 0;
+
+    disableNvicInterrupt(INT_TIMER1A);
+    modulation = mode;
+    modulationDepth = depth;
+    modulationScale = (scale > 2147483520.0f) ? 2147483520 : (int32_t)scale;
+    enableNvicInterrupt(INT_TIMER1A);
+    selectTimer1Isr();
+}
 
-    }
+// Returns the DAC A word for the current phase through the calibration
+uint16_t calcSampleA()
+{
+    return calcDacCode(DACA, calcVoltageA());
+}
 
-    if (voltage < 0 )
-    {
-        voltage = 0;
-    }
-    if (voltage > 2.048 )
-    {
-        voltage = 2.048;
-    }
+uint16_t calcSampleB()
+{
+    int32_t shape;
+    int32_t v;
 
-    sprintf(str, "D:    %4u, R:    %4u, R:    %4f\n", D,R,voltage );
-    putsUart0(str);
+    if (quarterSineB)
+        shape = interpolateB ? calcQuarterSineInterpolated(phaseB + phaseOffsetB) : calcQuarterSine(phaseB + phaseOffsetB);
+    else
+        shape = interpolateB ? calcShapeInterpolated(shapeB, phaseB) : shapeB[phaseB >> PHASE_SHIFT];
+    v = offsetB + ((shape * amplitudeB) >> 15);
 
-    sendData(D);
+    if (v > VOLT_MAX_Q12) v = VOLT_MAX_Q12;
+    if (v < -VOLT_MAX_Q12) v = -VOLT_MAX_Q12;
+    return calcDacCode(DACB, v);
 }
 
-void setOpampVoltageOut (DAC DAC_SEL, float voltage)
+// Advance the channel A accumulator by one sample
+void stepChannelA()
 {
-    float DACvolts;
-    char str[100];
-    if (voltage < -5 )
+    uint32_t phase = phaseA;
+    int32_t deviation;
+
+    if (modulation != MOD_OFF)
     {
-        voltage = -5;
+        if (modulationStepsB)
+            phaseB += tuningWordB;
+        if (modulation == MOD_FM)
+        {
+            // The carrier may have dropped below the deviation since 'mod' (a new frequency,
+            // a sweep), stop at zero so the accumulator never runs backward past a wrap
+            deviation = (int32_t)(((int64_t)modulationScale * calcModulationSource()) >> 15);
+            if (deviation < 0 && (uint32_t)-deviation > tuningWordA)
+                deviation = -(int32_t)tuningWordA;
+            phaseA += deviation;
+        }
     }
-    if (voltage > 5 )
+    phaseA += tuningWordA;
+    if (phaseA < phase)
     {
-        voltage = 5;
+        // Finished 1 Period (accumulator wrapped), queued settings take effect here
+        if (channelUpdates[DACA].pending)
+            applyChannelUpdate(DACA);
+        if (N_cycles_A > 0)
+        {
+            N_cycles_A--;
+            if (N_cycles_A == 0)
+                installTimer1Isr();
+        }
     }
-
-    DACvolts = (voltage - 5) / -5;
-    sprintf(str, "DACvolts:    %4f, voltage:    %4f\n", DACvolts,voltage );
-    putsUart0(str);
-
-    setDacVoltage (DAC_SEL, DACvolts);
+    if (sweeps[DACA].mode != SWEEP_OFF)
+        stepSweep(DACA);
 }
 
-
-uint16_t calcDACDataForOpampVoltage(DAC DAC_SEL, float voltage)
+// Advance the channel B accumulator by one sample
+void stepChannelB()
 {
+    uint32_t phase = phaseB;
 
-    float DACvolts;
-    int16_t R = 0;
-    uint16_t D = 0;
-    uint16_t DAC = 0;
-
-    if (voltage < -5 )
-    {
-        voltage = -5;
-    }
-    if (voltage > 5 )
+    phaseB += tuningWordB;
+    if (phaseB < phase)
     {
-        voltage = 5;
+        // Finished 1 Period (accumulator wrapped), queued settings take effect here
+        if (channelUpdates[DACB].pending)
+            applyChannelUpdate(DACB);
+        if (N_cycles_B > 0)
+        {
+            N_cycles_B--;
+            if (N_cycles_B == 0)
+                installTimer1Isr();
+        }
     }
+    if (sweeps[DACB].mode != SWEEP_OFF)
+        stepSweep(DACB);
+}
+
+// Moves a channel's tuning word one sample along its sweep, called by the output path
+void stepSweep(DAC DAC_SEL)
+{
+    SWEEP* sweep = &sweeps[DAC_SEL];
 
-    DACvolts = ((-0.00009 * pow(voltage,3)) + (0.0002 * pow(voltage,2)) - (0.1888 * voltage) +  1.0172); // most recent
+    if (sweep->mode == SWEEP_LINEAR)
+        sweep->tuningWord += sweep->step;
+    else
+        sweep->tuningWord += (int64_t)(int32_t)(sweep->tuningWord >> 32) * sweep->ratio;
 
-    if (DACvolts < 0 )
-    {
-        DACvolts = 0;
-    }
-    if (DACvolts > 2.048 )
+    if (--sweep->remaining == 0)
     {
-        DACvolts = 2.048;
+        if (sweep->repeat)
+        {
+            sweep->tuningWord = sweep->start;
+            sweep->remaining = sweep->samples;
+        }
+        else
+        {
+            // Land exactly on the stop frequency and hold it
+            sweep->tuningWord = sweep->stop;
+            sweep->mode = SWEEP_OFF;
+            if (DAC_SEL == DACA)
+                frequencyA = sweep->stopFrequency;
+            else
+                frequencyB = sweep->stopFrequency;
+            installTimer1Isr();
+        }
+    }
+
+    if (DAC_SEL == DACA)
+        tuningWordA = (uint32_t)(sweep->tuningWord >> 32);
+    else
+        tuningWordB = (uint32_t)(sweep->tuningWord >> 32);
+}
+
+// Plans a channel's sweep from its start and stop frequencies and duration at the current
+// sample rate, then hands it to the output path starting at the start frequency
+void startSweep(DAC DAC_SEL, SWEEP_MODE mode)
+{
+    SWEEP* sweep = &sweeps[DAC_SEL];
+    float samples = sweep->duration * sampleRate;
+    uint32_t start = calcTuningWord(sweep->startFrequency);
+    uint32_t stop = calcTuningWord(sweep->stopFrequency);
+    float ratio;
+
+    disableNvicInterrupt(INT_TIMER1A);
+
+    // Below Nyquist so the integer part fits the signed multiply in stepSweep
+    if (start > 0x7FFFFFFF) start = 0x7FFFFFFF;
+    if (stop > 0x7FFFFFFF) stop = 0x7FFFFFFF;
+    if (samples < 1) samples = 1;
+    if (samples > 4e9f) samples = 4e9f;
+
+    sweep->start = (uint64_t)start << 32;
+    sweep->stop = (uint64_t)stop << 32;
+    sweep->samples = (uint32_t)samples;
+    sweep->step = ((int64_t)sweep->stop - (int64_t)sweep->start) / sweep->samples;
+
+    // Per-sample growth (stop/start)^(1/samples) - 1, limited so it fits Q32 in 32 bits
+    ratio = (start > 0 && stop > 0) ? expm1f(logf((float)stop / start) / sweep->samples) : 0;
+    if (ratio > 0.49f) ratio = 0.49f;
+    if (ratio < -0.49f) ratio = -0.49f;
+    sweep->ratio = (int32_t)(ratio * 4294967296.0f);
+
+    sweep->tuningWord = sweep->start;
+    sweep->remaining = sweep->samples;
+    sweep->mode = mode;
+    if (DAC_SEL == DACA)
+        tuningWordA = start;
+    else
+        tuningWordB = start;
+
+    enableNvicInterrupt(INT_TIMER1A);
+    selectTimer1Isr();
+}
+
+// Ends a channel's sweep, the channel holds the frequency it had reached
+void stopSweep(DAC DAC_SEL)
+{
+    if (sweeps[DAC_SEL].mode == SWEEP_OFF)
+        return;
+
+    disableNvicInterrupt(INT_TIMER1A);
+    sweeps[DAC_SEL].mode = SWEEP_OFF;
+    enableNvicInterrupt(INT_TIMER1A);
+
+    if (DAC_SEL == DACA)
+        frequencyA = calcActualFrequency(tuningWordA);
+    else
+        frequencyB = calcActualFrequency(tuningWordB);
+    selectTimer1Isr();
+}
+
+// Render sample periods as DAC A / DAC B word pairs for the uDMA and pipelined paths
+// A channel that is not running repeats its last word so the DAC holds its level
+void renderSamples(uint16_t buffer[], uint16_t samples)
+{
+    uint16_t i;
+
+    for (i = 0; i < samples; i++)
+    {
+        if (differential == ON)
+        {
+            if (N_cycles_A == -1 || N_cycles_A > 0)
+            {
+                int32_t v = calcVoltageA();
+
+                lastWordA = calcDacCode(DACA, v);
+                lastWordB = calcDacCode(DACB, -v);
+                stepChannelA();
+            }
+        }
+        else
+        {
+            if (N_cycles_A == -1 || N_cycles_A > 0)
+            {
+                lastWordA = calcSampleA();
+                stepChannelA();
+            }
+            if (N_cycles_B == -1 || N_cycles_B > 0)
+            {
+                lastWordB = calcSampleB();
+                stepChannelB();
+            }
+        }
+
+        buffer[2 * i] = lastWordA;
+        buffer[2 * i + 1] = lastWordB;
+    }
+}
+
+// Refill whichever ping-pong half the controller has finished with and re-arm it
+void refillDmaBuffers()
+{
+    if (getUdmaTransferMode(UDMA_CH_TIMER1A, false) == UDMA_CHCTL_XFERMODE_STOP)
+    {
+        renderSamples(dmaBuffer[0], DMA_SAMPLES);
+        setUdmaTransfer(UDMA_CH_TIMER1A, false, dmaBuffer[0], &SSI1_DR_R, DMA_CONTROL);
+    }
+    if (getUdmaTransferMode(UDMA_CH_TIMER1A, true) == UDMA_CHCTL_XFERMODE_STOP)
+    {
+        renderSamples(dmaBuffer[1], DMA_SAMPLES);
+        setUdmaTransfer(UDMA_CH_TIMER1A, true, dmaBuffer[1], &SSI1_DR_R, DMA_CONTROL);
+    }
+}
+
+// Switch between per-sample ISR output and uDMA streaming
+void setOutputMode(OUTPUT mode)
+{
+    bool running = (TIMER1_CTL_R & TIMER_CTL_TAEN) != 0;
+
+    stopSampleClock();                               // turn-off timer while switching
+    disableUdmaChannel(UDMA_CH_TIMER1A);
+    outputMode = mode;
+
+    if (mode == OUT_DMA)
+    {
+        renderSamples(dmaBuffer[0], DMA_SAMPLES);
+        renderSamples(dmaBuffer[1], DMA_SAMPLES);
+        setUdmaTransfer(UDMA_CH_TIMER1A, false, dmaBuffer[0], &SSI1_DR_R, DMA_CONTROL);
+        setUdmaTransfer(UDMA_CH_TIMER1A, true, dmaBuffer[1], &SSI1_DR_R, DMA_CONTROL);
+        UDMA_PRIOSET_R = 1 << UDMA_CH_TIMER1A;
+        enableUdmaChannel(UDMA_CH_TIMER1A);
+        TIMER1_IMR_R = 0;                            // timeouts request uDMA only
+    }
+    else
+    {
+        TIMER1_IMR_R = TIMER_IMR_TATOIM;             // turn-on interrupts for timeout in timer module
+    }
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+    setLdacMode(ldacMode);
+    selectTimer1Isr();
+
+    if (running)
+    {
+        startSampleClock();
+    }
+}
+
+// Tuning word that advances the phase accumulator by Frequency/sampleRate of a turn per sample
+uint32_t calcTuningWord(float Frequency)
+{
+    if (Frequency < 0)
+    {
+        Frequency = 0;
+    }
+    if (Frequency > sampleRate / 2)
+    {
+        Frequency = sampleRate / 2;                   // Nyquist limit
+    }
+
+    return (uint32_t)(((double)Frequency * PHASE_SCALE) / sampleRate + 0.5);
+}
+
+// Frequency actually produced by a tuning word
+float calcActualFrequency(uint32_t tuningWord)
+{
+    return (double)tuningWord * sampleRate / PHASE_SCALE;
+}
+
+// Remember the requested frequency so a sample rate change can retune the channel,
+// a fixed frequency ends any sweep on the channel
+void setFrequency(DAC DAC_SEL, float Frequency)
+{
+    stopSweep(DAC_SEL);
+    if (DAC_SEL == DACA)
+    {
+        frequencyA = Frequency;
+        tuningWordA = calcTuningWord(Frequency);
+    }
+    else if (DAC_SEL == DACB)
+    {
+        frequencyB = Frequency;
+        tuningWordB = calcTuningWord(Frequency);
+    }
+}
+
+// Reprogram the sample clock (Timer1 and the LDAC timer) and retune both channels
+void setSampleRate(float rate)
+{
+    float cycles = (float)SYSTEM_CLOCK / rate + 0.5;
+    uint32_t load;
+
+    if (cycles < MIN_SAMPLE_LOAD + 1)
+    {
+        cycles = MIN_SAMPLE_LOAD + 1;
+    }
+    if (cycles > SYSTEM_CLOCK)
+    {
+        cycles = SYSTEM_CLOCK;                        // 1 Hz
+    }
+    load = (uint32_t)cycles - 1;
+
+    TIMER1_TAILR_R = load;
+    WTIMER3_TAILR_R = load;
+    if (TIMER1_CTL_R & TIMER_CTL_TAEN)
+    {
+        startSampleClock();                           // reload both counters with the new period
+    }
+
+    sampleRate = (float)SYSTEM_CLOCK / (load + 1);
+    tuningWordA = calcTuningWord(frequencyA);
+    tuningWordB = calcTuningWord(frequencyB);
+    if (sweeps[DACA].mode != SWEEP_OFF)
+        startSweep(DACA, sweeps[DACA].mode);         // sweeps are planned in samples, replan them
+    if (sweeps[DACB].mode != SWEEP_OFF)
+        startSweep(DACB, sweeps[DACB].mode);
+    if (modulation == MOD_FM)
+        setModulation(MOD_FM, modulationDepth);     // deviation is held as a tuning word
+    resetIsrStats();
+}
+
+// Highest sample rate the current output path and channel configuration can sustain
+// Uses the measured worst case (entry latency + ISR duration) when it is larger than the estimate
+float calcAutoSampleRate()
+{
+    uint32_t words;
+    uint32_t cycles;
+    uint32_t extra = 0;
+
+    // Differential mode reads channel A's table once and sends it twice
+    if (differential == ON)
+    {
+        words = 2;
+    }
+    else
+    {
+        words = ((N_cycles_A != 0) ? 1 : 0) + ((N_cycles_B != 0) ? 1 : 0);
+    }
+    if (N_cycles_A != 0 || differential == ON)
+    {
+        extra += (interpolateA ? CYCLES_INTERP : 0) + ((sweeps[DACA].mode != SWEEP_OFF) ? CYCLES_SWEEP : 0);
+    }
+    if (N_cycles_B != 0 && differential != ON)
+    {
+        extra += (interpolateB ? CYCLES_INTERP : 0) + ((sweeps[DACB].mode != SWEEP_OFF) ? CYCLES_SWEEP : 0);
+    }
+    if (modulation != MOD_OFF)
+    {
+        extra += CYCLES_MODULATION;
+    }
+
+    if (outputMode == OUT_DMA)
+    {
+        cycles = CYCLES_DMA + extra;
+    }
+    else if (pipeline == P_ON)
+    {
+        cycles = CYCLES_ISR_OVERHEAD + words * CYCLES_PIPELINED_WORD + extra;
+    }
+    else
+    {
+        cycles = CYCLES_ISR_OVERHEAD + words * CYCLES_BLOCKING_WORD + extra;
+    }
+
+    if (outputMode != OUT_DMA && isrStats.count > 0 && isrStats.maxLatency + isrStats.maxCycles > cycles)
+    {
+        cycles = isrStats.maxLatency + isrStats.maxCycles;
+    }
+
+    cycles = cycles / CPU_LOAD_TARGET;
+    if (cycles < MIN_SAMPLE_LOAD + 1)
+    {
+        cycles = MIN_SAMPLE_LOAD + 1;
+    }
+
+    return (float)SYSTEM_CLOCK / cycles;
+}
+
+// In auto rate mode, follow configuration changes with the rate calcAutoSampleRate picks
+// Streaming and measuring keep their rate; an unchanged timer load is left alone, which
+// also ends the recursion through setSampleRate (sweep and modulation replanning)
+void updateAutoSampleRate()
+{
+    float rate;
+
+    if (!autoRate || streaming || detectState != DETECT_OFF)
+        return;
+    rate = calcAutoSampleRate();
+    if ((uint32_t)((float)SYSTEM_CLOCK / rate + 0.5) - 1 != TIMER1_TAILR_R)
+        setSampleRate(rate);
+}
+
+// Phase is in units of pi, returns the equivalent table offset for a table spanning 2*pi
+int32_t calcPhaseIndex(float Phase)
+{
+    return (int32_t)floorf(Phase * (LUT_SIZE / 2) + 0.5f) & (LUT_SIZE - 1);
+}
+
+// The shape builders fill a normalized Q15 table using single-precision math only
+// (the FPU has no double support); amplitude and offset are applied at output time
+// Sine: the angle advances by rotating (cos, sin) one table step per entry
+void buildSineLut(int16_t shape[], float Phase)
+{
+    uint16_t i;
+    float stepCos = cosf(2.0f * PI_F / LUT_SIZE);
+    float stepSin = sinf(2.0f * PI_F / LUT_SIZE);
+    float x = cosf(Phase * PI_F);
+    float y = sinf(Phase * PI_F);
+    float t;
+
+    for (i = 0; i < LUT_SIZE; i++)
+    {
+        shape[i] = (int16_t)(y * 32767);
+
+        t = x * stepCos - y * stepSin;
+        y = x * stepSin + y * stepCos;
+        x = t;
+
+        // pull the vector back onto the unit circle so rounding does not accumulate
+        t = 1.5f - 0.5f * (x * x + y * y);
+        x *= t;
+        y *= t;
+    }
+}
+
+// Returns sin(phase) in Q15 from the quarter-wave table: the second and fourth
+// quadrants read the table backward, the second half of the period is negated
+int16_t calcQuarterSine(uint32_t phase)
+{
+    uint32_t index = phase >> (32 - SINE_BITS);
+    uint32_t q = index & (QUARTER_SIZE - 1);
+    int16_t s;
+
+    if (index & QUARTER_SIZE)
+        q = QUARTER_SIZE - q;
+    s = LUT_QUARTER_SINE [q];
+    return (index & (2 * QUARTER_SIZE)) ? -s : s;
+}
+
+// Interpolates between the quarter-wave sine entry at phase and the next one
+int32_t calcQuarterSineInterpolated(uint32_t phase)
+{
+    int32_t s0 = calcQuarterSine(phase);
+    int32_t s1 = calcQuarterSine(phase + (1u << (32 - SINE_BITS)));
+    int32_t fraction = (phase >> (32 - SINE_BITS - INTERP_BITS)) & ((1 << INTERP_BITS) - 1);
+
+    return s0 + (((s1 - s0) * fraction) >> INTERP_BITS);
+}
+
+// Interpolates between a shape table entry and the next one (wrapping at the end of the period)
+int32_t calcShapeInterpolated(const int16_t shape[], uint32_t phase)
+{
+    uint32_t index = phase >> PHASE_SHIFT;
+    int32_t s0 = shape[index];
+    int32_t s1 = shape[(index + 1) & (LUT_SIZE - 1)];
+    int32_t fraction = (phase >> (PHASE_SHIFT - INTERP_BITS)) & ((1 << INTERP_BITS) - 1);
+
+    return s0 + (((s1 - s0) * fraction) >> INTERP_BITS);
+}
+
+// Square: high for the first half of the period, low for the second
+void buildSquareLut(int16_t shape[], float Phase)
+{
+    uint16_t i;
+    int32_t index;
+    int32_t phaseIndex = calcPhaseIndex(Phase);
+
+    for (i = 0; i < LUT_SIZE; i++)
+    {
+        index = (i + phaseIndex) & (LUT_SIZE - 1);
+        shape[i] = ((index > 0) && (index < LUT_SIZE / 2)) ? 32767 : -32767;
+    }
+}
+
+// Triangle: integer ramp folded at the quarter points, peaks at a quarter period like sine
+void buildTriangleLut(int16_t shape[], float Phase)
+{
+    uint16_t i;
+    int32_t index;
+    int32_t phaseIndex = calcPhaseIndex(Phase);
+
+    for (i = 0; i < LUT_SIZE; i++)
+    {
+        index = (i + phaseIndex) & (LUT_SIZE - 1);
+        if (index > LUT_SIZE * 3 / 4)
+            index -= LUT_SIZE;
+        else if (index > LUT_SIZE / 4)
+            index = LUT_SIZE / 2 - index;
+        shape[i] = (index * 32767) / (LUT_SIZE / 4);
+    }
+}
+
+// Sawtooth: integer ramp starting at 0, rising to +1 at mid-period where it wraps to -1,
+// then rising back to 0 (the atan(tan()) form); a phase of 1 (pi) shifts it by a whole period
+void buildSawtoothLut(int16_t shape[], float Phase)
+{
+    uint16_t i;
+    int32_t index;
+    int32_t phaseIndex = (int32_t)floorf(Phase * LUT_SIZE + 0.5f) & (LUT_SIZE - 1);
+
+    for (i = 0; i < LUT_SIZE; i++)
+    {
+        index = ((i + phaseIndex + LUT_SIZE / 2) & (LUT_SIZE - 1)) - LUT_SIZE / 2;
+        shape[i] = (index * 32767) / (LUT_SIZE / 2);
+    }
+}
+
+// Sets the amplitude and offset queued for a channel's shape, in volts at the opamp output
+void setChannelScale(DAC DAC_SEL, float Amplitude, float offset)
+{
+    int32_t amplitude = Amplitude * VOLT_Q12;
+    int32_t ofs = offset * VOLT_Q12;
+
+    // keep shape * amplitude inside 32 bits and the sum inside the calibration span
+    if (amplitude > 2 * VOLT_MAX_Q12) amplitude = 2 * VOLT_MAX_Q12;
+    if (amplitude < -2 * VOLT_MAX_Q12) amplitude = -2 * VOLT_MAX_Q12;
+    if (ofs > VOLT_MAX_Q12) ofs = VOLT_MAX_Q12;
+    if (ofs < -VOLT_MAX_Q12) ofs = -VOLT_MAX_Q12;
+
+    channelUpdates[DAC_SEL].amplitude = amplitude;
+    channelUpdates[DAC_SEL].offset = ofs;
+}
+
+// Takes a channel's queued update: the new shape table replaces the current one, which
+// becomes the spare. Runs in the output path, or with the Timer1 interrupt held off
+void applyChannelUpdate(DAC DAC_SEL)
+{
+    volatile CHANNEL_UPDATE* update = &channelUpdates[DAC_SEL];
+    bool quarterSine = (DAC_SEL == DACA) ? quarterSineA : quarterSineB;
+
+    if (DAC_SEL == DACA)
+    {
+        if (update->shape != NULL)
+        {
+            spareShape = shapeA;
+            shapeA = update->shape;
+        }
+        quarterSineA = update->quarterSine;
+        phaseOffsetA = update->phaseOffset;
+        amplitudeA = update->amplitude;
+        offsetA = update->offset;
+    }
+    else
+    {
+        if (update->shape != NULL)
+        {
+            spareShape = shapeB;
+            shapeB = update->shape;
+        }
+        quarterSineB = update->quarterSine;
+        phaseOffsetB = update->phaseOffset;
+        amplitudeB = update->amplitude;
+        offsetB = update->offset;
+    }
+    update->pending = false;
+    if (update->quarterSine != quarterSine)
+        installTimer1Isr();                          // the handler reads a fixed table
+}
+
+// Applies a channel's queued update now instead of waiting for the period boundary
+void flushChannelUpdate(DAC DAC_SEL)
+{
+    disableNvicInterrupt(INT_TIMER1A);
+    if (channelUpdates[DAC_SEL].pending)
+        applyChannelUpdate(DAC_SEL);
+    enableNvicInterrupt(INT_TIMER1A);
+}
+
+// Queues a channel's update for its next accumulator wrap. A channel that is not
+// advancing (timer off, idle, B in differential mode) or has a period longer than
+// SWAP_MAX_PERIOD would hold the update too long, it is applied immediately
+void commitChannelUpdate(DAC DAC_SEL)
+{
+    uint32_t tuningWord = (DAC_SEL == DACA) ? tuningWordA : tuningWordB;
+    int cycles = (DAC_SEL == DACA) ? N_cycles_A : N_cycles_B;
+    bool advancing = (TIMER1_CTL_R & TIMER_CTL_TAEN) && (cycles != 0)
+                     && !(DAC_SEL == DACB && differential == ON)
+                     && ((float)tuningWord * sampleRate * SWAP_MAX_PERIOD >= 4294967296.0f);
+
+    channelUpdates[DAC_SEL].pending = true;
+    if (!advancing)
+        flushChannelUpdate(DAC_SEL);
+}
+
+// Returns the spare table for a new shape. The other channel may still be waiting to
+// swap it in, give it up to SWAP_TIMEOUT cycles to reach its period boundary
+int16_t* claimSpareShape(DAC DAC_SEL)
+{
+    DAC other = (DAC_SEL == DACA) ? DACB : DACA;
+    uint32_t start = DWT_CYCCNT_R;
+
+    while (channelUpdates[other].pending && channelUpdates[other].shape != NULL
+           && (DWT_CYCCNT_R - start) < SWAP_TIMEOUT)
+        ;
+    if (channelUpdates[other].shape != NULL)
+        flushChannelUpdate(other);
+    return spareShape;
+}
+
+// Rebuilds a channel's shape only when the waveform or phase changed, amplitude and
+// offset changes only update the channel scale. The shape is built into the spare table
+// and the whole change is queued for the channel's next period boundary, so the output
+// never reads a half-written table and the accumulator keeps running
+void buildLut(DAC DAC_SEL, WAVEFORM waveform, float Amplitude, float offset, float Phase)
+{
+    WAVE_CONFIG* config = &waveConfig[DAC_SEL];
+    volatile CHANNEL_UPDATE* update = &channelUpdates[DAC_SEL];
+    bool quarter = (waveform == W_SINE) && (sineTable == SINE_QUARTER);
+    int16_t* shape;
+
+    // Replace an update still waiting for its boundary, keeping any table it carries
+    disableNvicInterrupt(INT_TIMER1A);
+    shape = update->pending ? update->shape : NULL;
+    update->pending = false;
+    enableNvicInterrupt(INT_TIMER1A);
+
+    // The quarter-wave sine takes its phase as an accumulator offset, the shape table is left alone
+    if (quarter)
+    {
+        shape = NULL;
+        config->built = false;
+        config->waveform = waveform;
+        config->phase = Phase;
+    }
+    else if (waveform != W_ARB && (!config->built || config->waveform != waveform || config->phase != Phase))
+    {
+        shape = claimSpareShape(DAC_SEL);
+        lutBuilders[waveform](shape, Phase);
+        config->built = true;
+        config->waveform = waveform;
+        config->phase = Phase;
+    }
+    config->amplitude = Amplitude;
+    config->offset = offset;
+
+    update->shape = shape;
+    update->quarterSine = quarter;
+    update->phaseOffset = (uint32_t)(int32_t)floorf(Phase * (1 << 15) + 0.5f) << 16;  // pi = 2^31
+    setChannelScale(DAC_SEL, Amplitude, offset);
+    commitChannelUpdate(DAC_SEL);
+}
+
+// CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF), one byte at a time
+uint16_t updateCrc16(uint16_t crc, uint8_t data)
+{
+    uint8_t i;
+
+    crc ^= (uint16_t)data << 8;
+    for (i = 0; i < 8; i++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+// Waits up to ARB_TIMEOUT cycles for the next upload byte and adds it to the CRC
+bool readUploadByte(uint8_t* data, uint16_t* crc)
+{
+    uint32_t start = DWT_CYCCNT_R;
+
+    while (!kbhitUart0())
+    {
+        if ((DWT_CYCCNT_R - start) > ARB_TIMEOUT)
+            return false;
+    }
+    *data = getcUart0();
+    *crc = updateCrc16(*crc, *data);
+    return true;
+}
+
+// Discards the rest of a rejected block until the host has been quiet for ARB_TIMEOUT,
+// so it does not reach the command line as garbage
+void drainUpload()
+{
+    uint8_t data;
+    uint16_t crc;
+
+    while (readUploadByte(&data, &crc));
+}
+
+// Stretches a period of length samples at the start of shape to LUT_SIZE entries by
+// linear interpolation, in place: working backward, entry i only reads entries at or
+// below i*length/LUT_SIZE + 1 <= i, which have not been overwritten yet. Entry 0 is
+// written last, so the wrap from the last sample back to the first reads the original
+void resampleShape(int16_t shape[], uint32_t length)
+{
+    int32_t i;
+    uint32_t position;
+    uint32_t index;
+    int32_t s0;
+    int32_t s1;
+    int32_t fraction;
+
+    for (i = LUT_SIZE - 1; i >= 0; i--)
+    {
+        position = (uint32_t)i * length;
+        index = position / LUT_SIZE;
+        fraction = ((position % LUT_SIZE) << INTERP_BITS) / LUT_SIZE;
+        s0 = shape[index];
+        s1 = shape[(index + 1 < length) ? index + 1 : 0];
+        shape[i] = s0 + (((s1 - s0) * fraction) >> INTERP_BITS);
+    }
+}
+
+void sinusoidalFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+{
+    setFrequency(DAC_SEL, Frequency);
+    buildLut(DAC_SEL, W_SINE, Amplitude, offset, Phase);
+}
+
+void squareFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+{
+    setFrequency(DAC_SEL, Frequency);
+    buildLut(DAC_SEL, W_SQUARE, Amplitude, offset, Phase);
+}
+
+void triangleFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+{
+    setFrequency(DAC_SEL, Frequency);
+    buildLut(DAC_SEL, W_TRIANGLE, Amplitude, offset, Phase);
+}
+
+void sawtoothFunction (DAC DAC_SEL, float Frequency, float Amplitude, float offset, float Phase)
+{
+    setFrequency(DAC_SEL, Frequency);
+    buildLut(DAC_SEL, W_SAWTOOTH, Amplitude, offset, Phase);
+}
+
+void sendData(uint16_t Data)
+{
+    _delay_cycles(2);       // 25ns * 2 = 50ns (min 40ns) Before CS Fall
+    writeSpi1Data(Data);
+    readSpi1Data();
+
+    // LDAC_TIMER and LDAC_CS latch in hardware, no GPIO work per sample
+    if (ldacMode == LDAC_GPIO)
+    {
+        _delay_cycles(2);       // 25ns * 2 = 50ns (min 40ns)
+        setPinValue(LDAC, 0);
+
+        _delay_cycles(5);       // 25ns * 5 = 125ns (min 100ns)
+        setPinValue(LDAC, 1);
+    }
+}
+
+// Queue both DAC words back-to-back in the SSI1 TX FIFO (8 deep) and return
+// without waiting on the SPI, the LDAC strobe then latches A and B together
+void sendDACsData(uint16_t DataA, uint16_t DataB)
+{
+    queueSpi1Data(DataA);
+    queueSpi1Data(DataB);
+
+    if (ldacMode == LDAC_GPIO)
+    {
+        // Software strobe has to wait for both frames, one pulse latches both
+        waitSpi1Idle();
+        _delay_cycles(2);       // 25ns * 2 = 50ns (min 40ns)
+        setPinValue(LDAC, 0);
+
+        _delay_cycles(5);       // 25ns * 5 = 125ns (min 100ns)
+        setPinValue(LDAC, 1);
+    }
+}
+
+void setDacVoltage (DAC DAC_SEL, float voltage)
+{
+
+    int16_t R = 0;
+    uint16_t D = 0;
+    uint16_t DAC = 0;
+    char str[100];
+
+    if (voltage < 0 )
+    {
+        voltage = 0;
+    }
+    if (voltage > 2.048 )
+    {
+        voltage = 2.048;
+    }
+
+    if (DAC_SEL == DACA)
+    {
+        //voltage = voltage + DAC_A_OFFSET;
+        R = (2005.1 * voltage) - 7.7708;
+        if (R < 0) R = 0;
+        if (R > 4095) R = 4095;
+        DAC = 0x3 << 12;
+        D = (DAC) | (R & 0x0FFF);
+
+    }
+    else if (DAC_SEL == DACB)
+    {
+        //voltage = voltage + DAC_B_OFFSET;
+        R = (2005.1 * voltage) - 7.7708;
+        DAC = 0xB << 12;
+        D = (DAC) | (R & 0x0FFF);
+
+    }
+
+    if (voltage < 0 )
+    {
+        voltage = 0;
+    }
+    if (voltage > 2.048 )
+    {
+        voltage = 2.048;
+    }
+
+    sprintf(str, "D:    %4u, R:    %4u, R:    %4f\n", D,R,voltage );
+    putsUart0(str);
+
+    setDacWord(DAC_SEL, D);
+}
+
+void setDacWord(DAC DAC_SEL, uint16_t D)
+{
+    // The uDMA and pipelined paths repeat the last word of an idle channel, hold the level there
+    if (DAC_SEL == DACA)
+        lastWordA = D;
+    else
+        lastWordB = D;
+
+    if (outputMode != OUT_DMA)
+    {
+        sendData(D);
+    }
+}
+
+// DC output goes through the channel's calibration table like the waveforms, so 'cal'
+// changes the DC level too (it used to be the uncalibrated (v - 5) / -5 mapping)
+void setOpampVoltageOut (DAC DAC_SEL, float voltage)
+{
+    uint16_t D;
+    char str[100];
+    if (voltage < -5 )
+    {
+        voltage = -5;
+    }
+    if (voltage > 5 )
+    {
+        voltage = 5;
+    }
+
+    D = calcDACDataForOpampVoltage(DAC_SEL, voltage);
+    sprintf(str, "D:    %4u, voltage:    %4f\n", D & 0x0FFF, voltage );
+    putsUart0(str);
+
+    setDacWord(DAC_SEL, D);
+}
+
+// Fills a channel's calibration table from its coefficients, entry k holds the DAC code
+// (Q4) for an opamp output of (k << CAL_SHIFT) - 32768 in Q12 volts
+void buildCalTable(DAC DAC_SEL)
+{
+    uint16_t k;
+    float voltage;
+    float DACvolts;
+    float R;
+    CAL_COEFFS* cal = &calCoeffs[DAC_SEL];
+
+    for (k = 0; k <= CAL_SEGMENTS; k++)
+    {
+        voltage = ((int32_t)(k << CAL_SHIFT) - 32768) / VOLT_Q12;
+        if (voltage < -5 )
+        {
+            voltage = -5;
+        }
+        if (voltage > 5 )
+        {
+            voltage = 5;
+        }
+
+        DACvolts = ((cal->c3 * voltage + cal->c2) * voltage + cal->c1) * voltage + cal->c0;
+        if (DACvolts < 0 )
+        {
+            DACvolts = 0;
+        }
+        if (DACvolts > 2.048f )
+        {
+            DACvolts = 2.048f;
+        }
+
+        R = cal->gain * DACvolts + cal->offset;
+        if (R < 0) R = 0;
+        if (R > 4095) R = 4095;
+        calTable[DAC_SEL][k] = (uint16_t)(R * 16 + 0.5f);
+    }
+}
+
+// Returns the DAC word for an opamp output voltage in Q12 volts (1 V = 4096),
+// interpolating linearly between calibration table entries
+uint16_t calcDacCode(DAC DAC_SEL, int16_t voltage)
+{
+    uint16_t position = (uint16_t)((int32_t)voltage + 32768);
+    uint16_t index = position >> CAL_SHIFT;
+    uint16_t fraction = position & ((1 << CAL_SHIFT) - 1);
+    uint16_t* table = calTable[DAC_SEL];
+    uint32_t code;
+
+    code = ((uint32_t)table[index] * ((1 << CAL_SHIFT) - fraction) + (uint32_t)table[index + 1] * fraction) >> CAL_SHIFT;
+    return ((DAC_SEL == DACA) ? (0x3 << 12) : (0xB << 12)) | ((code + 8) >> 4);
+}
+
+uint16_t calcDACDataForOpampVoltage(DAC DAC_SEL, float voltage)
+{
+    if (voltage < -5 )
+    {
+        voltage = -5;
+    }
+    if (voltage > 5 )
+    {
+        voltage = 5;
+    }
+
+    return calcDacCode(DAC_SEL, (int16_t)(voltage * VOLT_Q12));
+}
+
+
+//-----------------------------------------------------------------------------
+// Commands
+//-----------------------------------------------------------------------------
+
+// Returns the DAC selected by a field (DACA or 0, DACB or 1), DAC A for anything else
+DAC getFieldDac(USER_DATA* data, uint8_t fieldNumber, char** name)
+{
+    if (isFieldEqual(data, fieldNumber, "daca") || isFieldEqual(data, fieldNumber, "0"))
+    {
+        *name = "DAC A";
+        return DACA;
+    }
+    if (isFieldEqual(data, fieldNumber, "dacb") || isFieldEqual(data, fieldNumber, "1"))
+    {
+        *name = "DAC B";
+        return DACB;
+    }
+    *name = "DAC A as default setting";
+    return DACA;
+}
+
+// Reads an ON/OFF field, returns false when the field is neither
+bool getFieldOnOff(USER_DATA* data, uint8_t fieldNumber, bool* on)
+{
+    *on = isFieldEqual(data, fieldNumber, "on");
+    return *on || isFieldEqual(data, fieldNumber, "off");
+}
+
+// Checks the arguments after the command name against a schema with one letter per
+// argument: N numeric, A alpha, X either; lowercase letters are optional and trail
+bool isSchemaValid(USER_DATA* data, const char schema[])
+{
+    uint8_t i;
+    uint8_t args = data->fieldCount - 1;
+
+    if (args > strlen(schema))
+        return false;
+    for (i = 0; schema[i] != '\0'; i++)
+    {
+        if (i >= args)
+            return islower(schema[i]);
+        if ((toupper(schema[i]) != 'X') && (tolower(schema[i]) != data->fieldType[i + 1]))
+            return false;
+    }
+    return true;
+}
+
+void dcCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    char *DAC_str;
+
+    DC = true;
+    DACSELECT = getFieldDac(data, 1, &DAC_str);
+    DcVoltage = getFieldFloat(data, 2);
+
+    sprintf(str, "Output voltage: %2f  in %s\n", DcVoltage, DAC_str );
+    putsUart0(str);
+
+    setOpampVoltageOut (DACSELECT, DcVoltage);
+}
+
+void cyclesCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    char *DAC_str;
+    int cycles;
+
+    DAC_SELECT_C = getFieldDac(data, 1, &DAC_str);
+    if (isFieldEqual(data, 2, "continuous") || isFieldEqual(data, 2, "c"))
+    {
+        cycles = -1;
+    }
+    else if (isFieldInteger(data, 2) && getFieldInteger(data, 2) <= INT32_MAX)
+    {
+        cycles = getFieldInteger(data, 2);
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+
+    if (DAC_SELECT_C == DACA)
+        N_cycles_A = cycles;
+    else
+        N_cycles_B = cycles;
+    selectTimer1Isr();
+
+    sprintf(str, "Wave on %s cyclesA %d  cyclesB %d  \n", DAC_str, N_cycles_A, N_cycles_B);
+    putsUart0(str);
+    phaseA = 0;
+    phaseB = 0;
+    cycles_A = N_cycles_A;
+    cycles_B = N_cycles_B;
+}
+
+// Shared by all waveform commands, arg selects the entry in waveFunctions
+void waveformCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    char *DAC_str;
+    DAC DAC_SELECT;
+    float Frequency;
+    float Amplitude;
+    float offset;
+    float Phase;
+
+    DC = false;
+    DAC_SELECT = getFieldDac(data, 1, &DAC_str);
+    Frequency = getFieldFloat(data, 2);
+    Amplitude = getFieldFloat(data, 3);
+    offset = getFieldFloat(data, 4);                 // optional, 0 V when missing
+    Phase = getFieldFloat(data, 5);                  // optional, 0 when missing
+
+    sprintf(str,"%s wave with: \n", waveNames[arg]);
+    putsUart0(str);
+    sprintf(str,"- Frequency = %2f \n", Frequency);
+    putsUart0(str);
+    sprintf(str,"- Actual Frequency = %f (resolution %f Hz) \n", calcActualFrequency(calcTuningWord(Frequency)), sampleRate / PHASE_SCALE);
+    putsUart0(str);
+    sprintf(str,"- Amplitude = %2f \n", Amplitude);
+    putsUart0(str);
+    sprintf(str,"- Offset = %2f \n", offset);
+    putsUart0(str);
+    sprintf(str,"- Phase = %2f \n", Phase);
+    putsUart0(str);
+
+    // The accumulators keep running so the change is phase-continuous
+    waveFunctions[arg](DAC_SELECT, Frequency, Amplitude, offset, Phase);
+}
+
+// Sweeps the channel's current waveform from FREQ1 to FREQ2 over TIME seconds inside the
+// output path, linear or logarithmic, once (then holding FREQ2) or repeating
+void sweepCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[160];
+    char *DAC_str;
+    DAC d;
+    SWEEP_MODE mode = SWEEP_LINEAR;
+    bool repeat = false;
+    uint8_t i;
+
+    d = getFieldDac(data, 1, &DAC_str);
+    if (isFieldEqual(data, 2, "off"))
+    {
+        stopSweep(d);
+        snprintf(str, sizeof(str), "Sweep OFF on %s, holding %f Hz \n", DAC_str, (d == DACA) ? frequencyA : frequencyB);
+        putsUart0(str);
+        return;
+    }
+    if (data->fieldType[2] != 'n' || data->fieldType[3] != 'n' || data->fieldType[4] != 'n'
+        || getFieldFloat(data, 4) <= 0)
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
     }
 
-    if (DAC_SEL == DACA)
+    for (i = 5; i < data->fieldCount; i++)
     {
-        R = (2005.1 * DACvolts) - 7.7708;
-        if (R < 0) R = 0;
-        if (R > 4095) R = 4095;
-        DAC = 0x3 << 12;
-        D = (DAC) | (R & 0x0FFF);
-
+        if (isFieldEqual(data, i, "log"))
+            mode = SWEEP_LOG;
+        else if (isFieldEqual(data, i, "repeat"))
+            repeat = true;
+        else if (!isFieldEqual(data, i, "lin") && !isFieldEqual(data, i, "once"))
+        {
+            putsUart0("Error in write command arguments\n");
+            return;
+        }
     }
-    else if (DAC_SEL == DACB)
+    if (mode == SWEEP_LOG && (getFieldFloat(data, 2) <= 0 || getFieldFloat(data, 3) <= 0))
     {
-        voltage = voltage + DAC_B_OFFSET;
-        DAC = 0xB << 12;
-        R = (DACvolts * 4096) / 2.048;
-        D = (DAC) | (R & 0x0FFF);
+        putsUart0("Log sweep needs frequencies above 0 Hz\n");
+        return;
     }
 
-    return D;
+    stopSweep(d);
+    sweeps[d].startFrequency = getFieldFloat(data, 2);
+    sweeps[d].stopFrequency = getFieldFloat(data, 3);
+    sweeps[d].duration = getFieldFloat(data, 4);
+    sweeps[d].repeat = repeat;
+    startSweep(d, mode);
 
+    snprintf(str, sizeof(str), "%s sweep on %s: %f Hz to %f Hz in %f s, %u samples, %s \n",
+            (mode == SWEEP_LOG) ? "Log" : "Linear", DAC_str, sweeps[d].startFrequency,
+            sweeps[d].stopFrequency, sweeps[d].duration, sweeps[d].samples, repeat ? "repeating" : "once");
+    putsUart0(str);
 }
 
+// Modulates channel A with channel B's waveform: AM depth 0..1, FM deviation in Hz,
+// PM deviation in units of pi. Channel B keeps its own output, or runs silently when idle
+void modCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[80];
+    MODULATION mode;
+    const char* modeNames[] = {"OFF", "AM", "FM", "PM"};
+
+    if (isFieldEqual(data, 1, "off"))
+        mode = MOD_OFF;
+    else if (isFieldEqual(data, 1, "am"))
+        mode = MOD_AM;
+    else if (isFieldEqual(data, 1, "fm"))
+        mode = MOD_FM;
+    else if (isFieldEqual(data, 1, "pm"))
+        mode = MOD_PM;
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    if (mode != MOD_OFF && data->fieldType[2] != 'n')
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
 
-//-----------------------------------------------------------------------------
-// Main
-//-----------------------------------------------------------------------------
+    setModulation(mode, getFieldFloat(data, 2));
+    resetIsrStats();
+    snprintf(str, sizeof(str), "Modulation %s of DAC A by DAC B, depth %f \n", modeNames[mode], modulationDepth);
+    putsUart0(str);
+}
 
-int main(void)
+// Receives one period of an arbitrary waveform for a channel. After "ready" the host sends:
+//   length (2 bytes, little endian, 2..65535 samples), format (1 byte, 12 or 16),
+//   samples: 16 - signed Q15, little endian; 12 - offset binary (2048 = 0 V), two samples
+//            packed into three bytes low nibble first, an odd last sample padded to 3 bytes
+//   CRC-16/CCITT of everything before it (2 bytes, high byte first)
+// The period goes into the spare table while the channel keeps playing: shorter periods
+// are interpolated up to LUT_SIZE entries, longer ones are decimated as they arrive.
+// Nothing changes unless the whole block arrives with a good CRC, then the table is swapped
+// in at the channel's next period boundary
+void arbCommand(USER_DATA* data, uint8_t arg)
 {
+    char str[80];
+    char *DAC_str;
+    DAC d;
+    int16_t* shape;
+    uint16_t crc = 0xFFFF;
+    uint8_t header[3];
+    uint8_t bytes[3];
+    uint32_t length;
+    uint8_t bits;
+    uint32_t k;
+    uint32_t index;
+    uint32_t last = 0xFFFFFFFF;
+    int32_t s;
+    uint8_t i;
+    bool ok = true;
+
+    d = getFieldDac(data, 1, &DAC_str);
+
+    // A table the channel is still waiting for must not be reused as the upload buffer
+    flushChannelUpdate(d);
+    shape = claimSpareShape(d);
+
+    while (kbhitUart0())
+        getcUart0();                                 // drop a trailing line feed
+    putsUart0("ready\n");
+
+    for (i = 0; i < 3 && ok; i++)
+        ok = readUploadByte(&header[i], &crc);
+    length = header[0] | ((uint32_t)header[1] << 8);
+    bits = header[2];
+    if (ok && (length < 2 || length > ARB_MAX_LENGTH || (bits != 12 && bits != 16)))
+    {
+        drainUpload();
+        putsUart0("Error in upload header\n");
+        return;
+    }
+
+    for (k = 0; k < length && ok; k++)
+    {
+        if (bits == 16)
+        {
+            ok = readUploadByte(&bytes[0], &crc) && readUploadByte(&bytes[1], &crc);
+            s = (int16_t)(bytes[0] | (bytes[1] << 8));
+        }
+        else
+        {
+            if ((k & 1) == 0)
+            {
+                for (i = 0; i < 3 && ok; i++)
+                    ok = readUploadByte(&bytes[i], &crc);
+                s = bytes[0] | ((bytes[1] & 0x0F) << 8);
+            }
+            else
+                s = (bytes[1] >> 4) | (bytes[2] << 4);
+            s = (s - 2048) << 4;
+        }
+        if (s < -32767) s = -32767;
+
+        // Longer periods keep the first sample that lands in each entry
+        index = (length > LUT_SIZE) ? (k * LUT_SIZE) / length : k;
+        if (index != last)
+            shape[index] = s;
+        last = index;
+    }
+
+    for (i = 0; i < 2 && ok; i++)
+        ok = readUploadByte(&bytes[i], &crc);
+    if (!ok)
+    {
+        drainUpload();
+        putsUart0("Upload timed out\n");
+        return;
+    }
+    if (crc != 0)
+    {
+        drainUpload();
+        putsUart0("Upload CRC error\n");
+        return;
+    }
+
+    if (length < LUT_SIZE)
+        resampleShape(shape, length);
+
+    // The table only becomes the channel's shape here, at its next period boundary
+    disableNvicInterrupt(INT_TIMER1A);
+    channelUpdates[d].pending = false;
+    enableNvicInterrupt(INT_TIMER1A);
+    setFrequency(d, getFieldFloat(data, 2));
+    waveConfig[d].built = true;
+    waveConfig[d].waveform = W_ARB;
+    waveConfig[d].phase = 0;
+    waveConfig[d].amplitude = getFieldFloat(data, 3);
+    waveConfig[d].offset = getFieldFloat(data, 4);
+    channelUpdates[d].shape = shape;
+    channelUpdates[d].quarterSine = false;
+    channelUpdates[d].phaseOffset = 0;
+    setChannelScale(d, waveConfig[d].amplitude, waveConfig[d].offset);
+    commitChannelUpdate(d);
+    DC = false;
+
+    sprintf(str,"Arbitrary wave on %s: %u samples (%u-bit) into %u entries \n", DAC_str, length, bits, LUT_SIZE);
+    putsUart0(str);
+}
 
-    char strInput[MAX_CHARS+1];
+// Plays samples pushed by the host on one channel at RATE samples/s. After "ready" the host
+// sends Q15 samples, 2 bytes little endian, and STREAM_END (0x8000) to finish. The main loop
+// moves them from the UART into the stream ring and sends XOFF/XON as the ring fills and
+// drains; playback starts once the ring is half full. The stream also ends after
+// STREAM_TIMEOUT without data, then the ring plays out and the statistics are reported
+void streamCommand(USER_DATA* data, uint8_t arg)
+{
     char str[100];
     char *DAC_str;
-    char *token;
-    int cycles_A;
-    int cycles_B;
-    float Frequency;
+    DAC d;
+    float rate;
+    float amplitude;
     float offset;
-    float Amplitude;
-    float Phase;
-    float DcVoltage;
-    DAC DAC_SELECT;
-    DAC DACSELECT;
-    bool valid;
-    bool ok;
-    bool DC;
+    uint8_t bytes[2];
+    uint8_t count = 0;
+    uint32_t lastData;
+    bool end = false;
+    bool running = (TIMER1_CTL_R & TIMER_CTL_TAEN) != 0;
+    char flow;
+    int16_t s;
+    STREAM_STATS stats;
+    UART_STATS uartStats;
+
+    if (outputMode != OUT_ISR)
+    {
+        putsUart0("Streaming needs output ISR\n");
+        return;
+    }
+    d = getFieldDac(data, 1, &DAC_str);
+    rate = getFieldFloat(data, 2);
+    amplitude = getFieldFloat(data, 3);
+    offset = getFieldFloat(data, 4);
+    if (rate <= 0)
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    if (rate > sampleRate)
+        rate = sampleRate;                           // at most one stream sample per output sample
 
-    // Initialize hardware
-    initHw();
-    initTimer();
-    initUart0();
-    initAdc0Ss3();
-    initAdc1Ss2();
+    sprintf(str,"Stream on %s at %f samples/s, the link sustains %u samples/s \n", DAC_str, rate, UART0_BAUD / 20);
+    putsUart0(str);
+    if (rate > UART0_BAUD / 20)
+        putsUart0("Rate above the link rate, expect underruns\n");
+
+    // Same limits as the channel scale
+    streamAmplitude = amplitude * VOLT_Q12;
+    streamOffset = offset * VOLT_Q12;
+    if (streamAmplitude > 2 * VOLT_MAX_Q12) streamAmplitude = 2 * VOLT_MAX_Q12;
+    if (streamAmplitude < -2 * VOLT_MAX_Q12) streamAmplitude = -2 * VOLT_MAX_Q12;
+    if (streamOffset > VOLT_MAX_Q12) streamOffset = VOLT_MAX_Q12;
+    if (streamOffset < -VOLT_MAX_Q12) streamOffset = -VOLT_MAX_Q12;
+    streamTuningWord = (rate >= sampleRate) ? 0xFFFFFFFF : (uint32_t)((double)rate * PHASE_SCALE / sampleRate);
+    streamPhase = 0;
+    streamSample = 0;
+    streamDac = d;
+    DC = false;
+    initStream();
+    startSampleClock();
 
-    // Setup UART0 baud rate
-    setUart0BaudRate(115200, 40e6);
+    while (kbhitUart0())
+        getcUart0();                                 // drop a trailing line feed
+    putsUart0("ready\n");
 
-    // Use AIN2 input with N=4 hardware sampling
-    setAdc0Ss3Mux(2);
-    setAdc0Ss3Log2AverageCount(2);
+    lastData = DWT_CYCCNT_R;
+    while (!end)
+    {
+        while (!end && kbhitUart0() && getStreamFree() > 0)
+        {
+            bytes[count++] = getcUart0();
+            if (count == 2)
+            {
+                count = 0;
+                s = (int16_t)(bytes[0] | (bytes[1] << 8));
+                end = (s == STREAM_END);
+                if (!end)
+                    writeStream(s);
+            }
+            lastData = DWT_CYCCNT_R;
+        }
+        if (getStreamCount() > STREAM_XON_LEVEL)
+            lastData = DWT_CYCCNT_R;                 // host paused or ring well stocked, waiting on playback
 
-    // Use AIN1 input with N=4 hardware sampling
-    setAdc1Ss2Mux(1);
-    setAdc1Ss2Log2AverageCount(2);
+        flow = updateStreamFlow();
+        if (flow && putcUart0(flow))
+            commitStreamFlow(flow);
 
-    putsUart0("Welcome to the Project\n");
-    DC = false;
-    while (true)
+        if (!streaming && (getStreamCount() >= STREAM_SIZE / 2))
+        {
+            streaming = true;
+            selectTimer1Isr();
+        }
+        if ((DWT_CYCCNT_R - lastData) > STREAM_TIMEOUT)
+            end = true;
+    }
+
+    // Play out what is buffered, then hand Timer1 back to the channels
+    closeStream();
+    if (!streaming)
     {
-        putsUart0("Please enter a command or write help to see all the commands \n");
-        // getsUart0(& data);
-        getsUart0(strInput, MAX_CHARS);
-        // putsUart0(data.buffer);
+        streaming = true;
+        selectTimer1Isr();
+    }
+    while (getStreamCount() > 0 && (TIMER1_CTL_R & TIMER_CTL_TAEN));
+    streaming = false;
+    selectTimer1Isr();
+    flow = updateStreamFlow();
+    if (flow)
+    {
+        waitUart0TxFree(1);                          // never leave the host paused
+        putcUart0(flow);
+        commitStreamFlow(flow);
+    }
+    if (!running)
+    {
+        stopSampleClock();
+    }
+
+    getStreamStats(&stats);
+    getUart0Stats(&uartStats);
+    snprintf(str, sizeof(str), "Stream done: %u samples, %u underruns, %u overruns, ring high water %u of %u \n",
+            stats.samples, stats.underruns, stats.overruns, stats.highWater, STREAM_SIZE);
+    putsUart0(str);
+    sprintf(str,"UART rx dropped %u \n", uartStats.rxDropped);
+    putsUart0(str);
+}
 
-        token = strtok(strInput, " \r\n");
-        ok = token != NULL;
-        valid = false;
+// Captures N simultaneous IN1/IN2 pairs at RATE pairs/s, PRE of them before the trigger (the
+// first rising crossing of LEVEL volts on input IN, immediate without a level), then sends:
+//   "data N RATE" line, N pairs of 12-bit ADC codes (IN1 then IN2, 2 bytes each, little endian),
+//   CRC-16/CCITT of the pairs (2 bytes, high byte first)
+// A key press or CAPTURE_TIMEOUT without a trigger cancels the capture
+void captureCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[60];
+    CAPTURE_INPUT input;
+    float rate;
+    uint32_t length;
+    uint32_t pre;
+    bool levelTrigger;
+    int32_t level;
+    uint32_t start;
+    uint16_t crc = 0xFFFF;
+    ADC_PAIR pair;
+    uint16_t i;
+
+    if (isFieldEqual(data, 1, "in1"))
+        input = CAPTURE_ADC0;
+    else if (isFieldEqual(data, 1, "in2"))
+        input = CAPTURE_ADC1;
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    length = getFieldInteger(data, 3);
+    pre = getFieldInteger(data, 4);
+    if (!isFieldInteger(data, 3) || !isFieldInteger(data, 4) || length == 0 || length > CAPTURE_MAX || pre > length)
+    {
+        sprintf(str,"N must be 1 to %u, PRE at most N \n", CAPTURE_MAX);
+        putsUart0(str);
+        return;
+    }
+    levelTrigger = (data->fieldCount > 5) && (data->fieldType[5] == 'n');
+    level = getFieldFloat(data, 5) * 4096 / ADC_FULL_SCALE;
+    if (level < 0) level = 0;
+    if (level > 4095) level = 4095;
 
+    rate = getFieldFloat(data, 2);
+    if (rate <= 0 || rate > CAPTURE_MAX_RATE)
+    {
+        sprintf(str,"RATE must be above 0 and at most %u \n", CAPTURE_MAX_RATE);
+        putsUart0(str);
+        return;
+    }
+    rate = setCaptureRate(rate);
+    startCapture(input, length, pre, levelTrigger, level);
 
-        if (strcmp(token, "dc") == 0)
+    start = DWT_CYCCNT_R;
+    while (!isCaptureDone())
+    {
+        if (kbhitUart0() || (DWT_CYCCNT_R - start) > CAPTURE_TIMEOUT)
         {
-            valid = true;
-            DC = true;
+            if (kbhitUart0())
+                getcUart0();                         // the key only cancels, it is not a command
+            stopCapture();
+            putsUart0(isCaptureTriggered() ? "Capture cancelled\n" : "Capture cancelled, no trigger\n");
+            return;
+        }
+    }
+    if (isCaptureOverrun())
+    {
+        putsUart0("Capture overrun, lower the rate\n");
+        return;
+    }
 
-            // DAC Select (DACA or 0 (outA) ////  DACB or 1 (outB ))
-            token = strtok(NULL, " ,");
-            ok = ok && token != NULL;
+    sprintf(str,"data %u %f\n", length, rate);
+    putsUart0(str);
+    for (i = 0; i < length; i++)
+    {
+        pair = getCapturePair(i);
+        crc = updateCrc16(updateCrc16(crc, pair.in1 & 0xFF), pair.in1 >> 8);
+        crc = updateCrc16(updateCrc16(crc, pair.in2 & 0xFF), pair.in2 >> 8);
+        waitUart0TxFree(4);                          // binary data must not be dropped
+        putcUart0(pair.in1 & 0xFF);
+        putcUart0(pair.in1 >> 8);
+        putcUart0(pair.in2 & 0xFF);
+        putcUart0(pair.in2 >> 8);
+    }
+    waitUart0TxFree(2);
+    putcUart0(crc >> 8);
+    putcUart0(crc & 0xFF);
+}
 
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DACSELECT = DACA;
-                DAC_str = "DAC A";
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DACSELECT = DACB;
-                DAC_str = "DAC B";
-            }
-            else
-            {
-                DACSELECT = DACA;
-                DAC_str = "DAC A as default setting";
-            }
+void stopCommand(USER_DATA* data, uint8_t arg)
+{
+    N_cycles_A = cycles_A;
+    N_cycles_B = cycles_B;
+    selectTimer1Isr();
 
-            // Dc Voltage
-            token = strtok(NULL, " ,");
-            ok = ok && token != NULL;
-            DcVoltage = atof(token);
+    stopSampleClock();
+}
 
-            if (ok)
-            {
-                sprintf(str, "Output voltage: %2f  in %s\n", DcVoltage, DAC_str );
-                putsUart0(str);
+void runCommand(USER_DATA* data, uint8_t arg)
+{
+    startSampleClock();
+}
 
-                setOpampVoltageOut (DACSELECT, DcVoltage);
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+void pauseCommand(USER_DATA* data, uint8_t arg)
+{
+    stopSampleClock();
+}
 
-        }
-        else if (strcmp(token, "cycles") == 0)
-        {
-            valid = true;
-            char *ncycle;
+void differentialCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[40];
+    bool on;
 
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
+    if (getFieldOnOff(data, 1, &on))
+    {
+        differential = on ? ON : OFF;
+        selectTimer1Isr();
+        sprintf(str,"Differential Mode %s \n", on ? "ON" : "OFF");
+        putsUart0(str);
+        phaseA = 0;
+        phaseB = 0;
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+    }
+}
 
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DAC_SELECT_C = DACA;
-                DAC_str = "DAC A";
+void outputCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[40];
+    char *mode;
+
+    if (isFieldEqual(data, 1, "dma"))
+    {
+        setOutputMode(OUT_DMA);
+        mode = "uDMA";
+    }
+    else if (isFieldEqual(data, 1, "isr"))
+    {
+        setOutputMode(OUT_ISR);
+        mode = "ISR";
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
 
-                // Number of cycles
-                token = strtok(NULL, " ,");
-                ok = ok && token != NULL;
+    sprintf(str,"Output Mode %s \n", mode);
+    putsUart0(str);
+}
 
-                if (ok)
-                {
-                    if(strcmp(token, "continuous") == 0 || strcmp(token, "c") == 0)
-                    {
-                        N_cycles_A = -1;
-                        ncycle = token;
-                    }
-                    else
-                    {
-                        N_cycles_A = atof(token);
-                        ncycle = token;
-                    }
+void ldacCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[60];
+    char *mode;
 
-                }
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DAC_SELECT_C = DACB;
-                DAC_str = "DAC B";
+    if (isFieldEqual(data, 1, "timer"))
+    {
+        setLdacMode(LDAC_TIMER);
+        mode = "timer strobe (A and B simultaneous)";
+    }
+    else if (isFieldEqual(data, 1, "gpio"))
+    {
+        setLdacMode(LDAC_GPIO);
+        mode = "GPIO pulse per word";
+    }
+    else if (isFieldEqual(data, 1, "cs"))
+    {
+        setLdacMode(LDAC_CS);
+        mode = "latch on CS";
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
 
-                // Number of cycles
-                token = strtok(NULL, " ,");
-                ok = ok && token != NULL;
+    sprintf(str,"LDAC %s \n", mode);
+    putsUart0(str);
+}
 
-                if (ok)
-                {
-                    if(strcmp(token, "continuous") == 0 || strcmp(token, "c") == 0)
-                    {
-                        N_cycles_B = -1;
-                        ncycle = token;
-                    }
-                    else
-                    {
-                        N_cycles_B = atof(token);
-                        ncycle = token;
-                    }
+void pipelineCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[40];
+    bool on;
 
-                }
-            }
-            else // If DACA or DACB not entered or entered but incorrect
-            {
-                DAC_SELECT_C = DACA;
-                DAC_str = "DAC A as default setting";
-                DAC_SELECT_C = DACA;
-                N_cycles_A = -1;
-            }
+    if (getFieldOnOff(data, 1, &on))
+    {
+        pipeline = on ? P_ON : P_OFF;
+        selectTimer1Isr();
+        sprintf(str,"Pipelined FIFO writes %s \n", on ? "ON" : "OFF");
+        putsUart0(str);
+        resetIsrStats();
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+    }
+}
 
-            if (ok)
-            {
-                sprintf(str, "Wave with %s cyclesA %d  cyclesB %d  \n", ncycle, N_cycles_A, N_cycles_B);
-                putsUart0(str);
-                countA = 0;
-                countB = 0;
-                cycles_A = N_cycles_A;
-                cycles_B = N_cycles_B;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+void statsCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    ISR_STATS stats = isrStats;                      // snapshot, the ISR keeps updating
+    UART_STATS uartStats;
 
-        }
-        else if (strcmp(token, "sine") == 0)
+    getUart0Stats(&uartStats);
+    if (isFieldEqual(data, 1, "reset"))
+    {
+        resetIsrStats();
+        resetUart0Stats();
+        putsUart0("ISR and UART statistics reset \n");
+        return;
+    }
+
+    if (stats.count == 0)
+    {
+        putsUart0("No ISR runs recorded \n");
+    }
+    else
+    {
+        sprintf(str,"ISR runs %u, budget %u cycles per sample (pipeline %s) \n",
+                stats.count, TIMER1_TAILR_R + 1, (pipeline == P_ON) ? "ON" : "OFF");
+        putsUart0(str);
+        sprintf(str,"Cycles min %u, mean %u, max %u \n",
+                stats.minCycles, (uint32_t)(stats.totalCycles / stats.count), stats.maxCycles);
+        putsUart0(str);
+        if (outputMode != OUT_DMA)
         {
-            valid = true;
-            DC = false;
-            // DAC Select (DACA or 0 (outA) ////  DACB or 1 (outB ))
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
+            sprintf(str,"Entry latency min %u, max %u, jitter %u cycles \n",
+                    stats.minLatency, stats.maxLatency, stats.maxLatency - stats.minLatency);
+            putsUart0(str);
+        }
+        sprintf(str,"Missed periods %u, overruns %u \n", stats.missed, stats.overruns);
+        putsUart0(str);
+    }
+    sprintf(str,"UART tx high %u, dropped %u, rx high %u, dropped %u \n",
+            uartStats.txHighWater, uartStats.txDropped, uartStats.rxHighWater, uartStats.rxDropped);
+    putsUart0(str);
+}
 
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A";
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DAC_SELECT = DACB;
-                DAC_str = "DAC B";
-            }
-            else
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A as default setting";
-            }
-            // Frequency
-            token = strtok(NULL, " ,");
-            ok = ok && token != NULL;
-            Frequency = atof(token);
-
-            // Amplitude
-            token = strtok(NULL, " ,");
-            ok = ok && token != NULL;
-            Amplitude = atof(token);
-
-            // Offset
-            token = strtok(NULL, " \r\n");
-            // Determine if offset set else default offset = 0 v
-            if (strlen(token) > 0)
-            {
-                offset = atof(token);
-            }
-            else
-            {
-                offset = 0;
-            }
+void rateCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    float rate;
 
-            // Phase
-            token = strtok(NULL, " \r\n");
-            // Determine if Phase set else default Phase = 0 v
-            if (strlen(token) > 0)
-            {
-                Phase = atof(token);
-            }
-            else
-            {
-                Phase = 0;
-            }
+    if (data->fieldCount < 2)
+    {
+        rate = sampleRate;                           // report only
+    }
+    else if (isFieldEqual(data, 1, "auto"))
+    {
+        autoRate = true;
+        rate = calcAutoSampleRate();
+    }
+    else
+    {
+        autoRate = false;
+        rate = getFieldFloat(data, 1);
+    }
 
+    if (rate > 0)
+    {
+        if (rate != sampleRate)
+        {
+            setSampleRate(rate);
+        }
+        sprintf(str,"Sample rate %f Hz (load %u), resolution %f Hz \n",
+                sampleRate, TIMER1_TAILR_R, sampleRate / PHASE_SCALE);
+        putsUart0(str);
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+    }
+}
 
-            if (ok)
-            {
-                putsUart0("Sine wave with: \n");
-                sprintf(str,"- Frequency = %2f \n", Frequency);
-                putsUart0(str);
-                sprintf(str,"- Amplitude = %2f \n", Amplitude);
-                putsUart0(str);
-                sprintf(str,"- Offset = %2f \n", offset);
-                putsUart0(str);
-                sprintf(str,"- Phase = %2f \n", Phase);
-                putsUart0(str);
-
-                // call sine function
-                // do some stuff here
-                sinusoidalFunction (DAC_SELECT, Frequency, Amplitude, offset, Phase);
-                countA = 0;
-                countB = 0;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+void resetCommand(USER_DATA* data, uint8_t arg)
+{
+    //reset the Microcontroller (Red board)
+    NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+}
+
+void voltageCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[40];
+    float Vin;
+
+    if (isFieldEqual(data, 1, "in1"))
+    {
+        Vin = ((float) readAdc0Ss3() * 5.0) / 4096.0;
+        sprintf(str,"Voltage IN1  %2.2f \n", Vin);
+        putsUart0(str);
+    }
+    else if (isFieldEqual(data, 1, "in2"))
+    {
+        Vin = ((float) readAdc1Ss2() * 5.0) / 4096.0;
+        sprintf(str,"Voltage IN2  %2.2f \n", Vin);
+        putsUart0(str);
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+    }
+}
 
-        }
-        else if (strcmp(token, "square") == 0)
+// Mean, AC RMS, min, max, peak-to-peak and frequency of IN1 and IN2 over N simultaneous pairs
+// at RATE pairs/s. A first pass finds each input's mean and swing; the second accumulates the
+// results and counts rising crossings of the mean with hysteresis, so it takes 2N samples
+void measureCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    const char* names[] = {"IN1", "IN2"};
+    MEASURE m[2];
+    float rate;
+    uint32_t count = MEASURE_DEFAULT_SAMPLES;
+    int32_t mean;
+    int32_t band;
+    uint64_t variance;
+    float scale = ADC_FULL_SCALE / 4096;
+    float frequency;
+    uint8_t i;
+
+    if (data->fieldCount > 2)
+        count = isFieldInteger(data, 2) ? getFieldInteger(data, 2) : 0;
+    if (count == 0 || count > MEASURE_MAX_SAMPLES)
+    {
+        sprintf(str,"N must be 1 to %u \n", MEASURE_MAX_SAMPLES);
+        putsUart0(str);
+        return;
+    }
+    rate = getFieldFloat(data, 1);
+    if (rate <= 0)
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    rate = setCaptureRate((rate > MEASURE_MAX_RATE) ? MEASURE_MAX_RATE : rate);
+
+    for (i = 0; i < 2; i++)
+        resetMeasure(&m[i], 0, 0xFFFF);              // nothing is below 0, no crossings
+    if (accumulatePairs(m, count))
+    {
+        for (i = 0; i < 2; i++)
         {
-            valid = true;
-            DC = false;
-            // DAC Select (DACA or 0 (outA) ////  DACB or 1 (outB ))
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
+            mean = m[i].sum / count;
+            band = (m[i].max - m[i].min) / 8;
+            if (band < MEASURE_HYSTERESIS)
+                band = MEASURE_HYSTERESIS;
+            resetMeasure(&m[i], (mean > band) ? mean - band : 0, (mean + band < 4095) ? mean + band : 4095);
+        }
+        accumulatePairs(m, count);
+    }
+    if (isAdcPairOverflow())
+    {
+        putsUart0("Measure overrun, lower the rate\n");
+        return;
+    }
+    if (kbhitUart0())
+    {
+        getcUart0();                                 // the key only cancels, it is not a command
+        putsUart0("Measure cancelled\n");
+        return;
+    }
 
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A";
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DAC_SELECT = DACB;
-                DAC_str = "DAC B";
-            }
-            else
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A as default setting";
-            }
+    sprintf(str,"%u samples at %.1f Hz \n", count, rate);
+    putsUart0(str);
+    for (i = 0; i < 2; i++)
+    {
+        // Exact in integers: N^2 times the variance
+        variance = (uint64_t)count * m[i].sumSquares - (uint64_t)m[i].sum * m[i].sum;
+        frequency = (m[i].crossings > 1) ? (m[i].crossings - 1) * rate / (m[i].last - m[i].first) : 0;
+        sprintf(str,"%s  mean %.3f  rms %.3f  min %.3f  max %.3f  p2p %.3f V  freq %.2f Hz \n", names[i],
+                (float)m[i].sum / count * scale, sqrtf((float)variance) / count * scale,
+                m[i].min * scale, m[i].max * scale, (m[i].max - m[i].min) * scale, frequency);
+        putsUart0(str);
+    }
+}
 
-            // Frequency
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Frequency = atof(token);
+// Bode table: at each planned frequency the response on IN2 (DUT output) against IN1 (DUT input)
+// by synchronous detection, gain in dB and phase in degrees. The plan is FREQ1 to FREQ2, log
+// (POINTS per decade, default) or linear (POINTS in total), endpoints included; each point's
+// settling and integration lengths come from planGainPoint
+void gainCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    GAIN_PLAN plan;
+    uint16_t i;
+    uint32_t settle;
+    uint32_t periods;
+    uint32_t start;
+    float frequency;
+    float duration = 0;
+    float elapsed = 0;
+    float GaindB;
+    float Phase;
+    DETECT_RESULT result[2];
+    uint8_t modeField = 4;
+
+    // POINTS and LOG|LIN are both optional, the mode may directly follow FREQ2
+    if (data->fieldCount > 3 && data->fieldType[3] == 'a')
+        modeField = 3;
+    plan.start = getFieldFloat(data, 1);
+    plan.stop = getFieldFloat(data, 2);
+    plan.density = GAIN_DEFAULT_POINTS;
+    if (modeField == 4 && data->fieldCount > 3)      // 2.5, -3, 1e3 or more than the sweep holds are rejected
+        plan.density = (isFieldInteger(data, 3) && getFieldInteger(data, 3) <= GAIN_MAX_POINTS) ? getFieldInteger(data, 3) : 0;
+    plan.log = !isFieldEqual(data, modeField, "lin");
+    if (plan.start <= 0 || plan.stop <= 0 || plan.density == 0 || data->fieldCount > modeField + 1
+        || (data->fieldCount > modeField && plan.log && !isFieldEqual(data, modeField, "log")))
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    plan.points = countGainPoints(&plan);
 
-            // Amplitude
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Amplitude = atof(token);
+    for (i = 0; i < plan.points; i++)
+    {
+        frequency = calcActualFrequency(calcTuningWord(calcGainPoint(&plan, i)));
+        planGainPoint(frequency, &settle, &periods);
+        duration += (settle + periods + 1) / frequency;
+    }
+    sprintf(str,"%s sweep, %u points, estimated %.2f s \n", plan.log ? "Log" : "Linear", plan.points, duration);
+    putsUart0(str);
 
-            // Offset
-            token = strtok(NULL, " \r\n");
-            // Determine if offset set else default offset = 0 v
-            if (strlen(token) > 0)
-            {
-                offset = atof(token);
-            }
-            else
-            {
-                offset = 0;
-            }
+    sinusoidalFunction (DACA, plan.start, 4,  0, 0); // sine wave function
+    N_cycles_A = -1;
+    selectTimer1Isr();
+    startSampleClock();
 
-            // Phase
-            token = strtok(NULL, " \r\n");
-            // Determine if Phase set else default Phase = 0 v
-            if (strlen(token) > 0)
-            {
-                Phase = atof(token);
-            }
-            else
-            {
-                Phase = 0;
-            }
+    putsUart0("-----------------------------------------------------\n");
+    putsUart0("| Frequency  |  Gain (dB) | Phase (deg) |  Periods  |\n");
+    putsUart0("-----------------------------------------------------\n");
 
-            if (ok)
-            {
-                putsUart0("“square wave with: \n");
-                sprintf(str,"- Frequency = %2f \n", Frequency);
-                putsUart0(str);
-                sprintf(str,"- Amplitude = %2f \n", Amplitude);
-                putsUart0(str);
-                sprintf(str,"- Offset = %2f \n", offset);
-                putsUart0(str);
-                sprintf(str,"- Phase = %2f \n", Phase);
-                putsUart0(str);
-
-
-                // call square function
-                squareFunction (DAC_SELECT, Frequency, Amplitude, offset, Phase);
-                countA = 0;
-                countB = 0;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+    for (i = 0; i < plan.points; i++)
+    {
+        frequency = calcActualFrequency(calcTuningWord(calcGainPoint(&plan, i)));
+        planGainPoint(frequency, &settle, &periods);
 
+        start = DWT_CYCCNT_R;
+        if (!measureResponse(frequency, settle, periods, result) || result[0].amplitude == 0)
+        {
+            sprintf(str,"|%10.2f  |   no measurement         | %9u |\n", frequency, periods);
         }
-        else if (strcmp(token, "triangle") == 0)
+        else
         {
-            valid = true;
-            DC = false;
-            // DAC Select (DACA or 0 (outA) ////  DACB or 1 (outB ))
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
+            GaindB = 20 * log10f(result[1].amplitude / result[0].amplitude);
+            Phase = result[1].phase - result[0].phase;
+            if (Phase > 180) Phase -= 360;
+            if (Phase < -180) Phase += 360;
+            sprintf(str,"|%10.2f  |   %7.2f  |   %6.1f    | %9u |\n", frequency, GaindB, Phase, periods);
+        }
+        elapsed += (float)(DWT_CYCCNT_R - start) / SYSTEM_CLOCK;
+        waitUart0TxFree(strlen(str));                // pace the table instead of dropping rows
+        putsUart0(str);
+    }
+    sinusoidalFunction (DACA, 0, 0,  0, 0); // sine wave function
 
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A";
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DAC_SELECT = DACB;
-                DAC_str = "DAC B";
-            }
-            else
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A as default setting";
-            }
+    sprintf(str,"Sweep took %.2f s of measurement \n", elapsed);
+    putsUart0(str);
+}
 
-            // Frequency
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Frequency = atof(token);
+void levelCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[40];
+    bool on;
 
-            // Amplitude
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Amplitude = atof(token);
+    if (DC && (DACSELECT == DACA))
+    {
+        if (getFieldOnOff(data, 1, &on))
+        {
+            float adcVoltageIn;
+            uint16_t rawA = readAdc0Ss3();
+            adcVoltageIn = (rawA * 3.3) / 4096;
 
-            // Offset
-            token = strtok(NULL, " \r\n");
-            // Determine if offset set else default offset = 0 v
-            if (strlen(token) > 0)
-            {
-                offset = atof(token);
-            }
-            else
-            {
-                offset = 0;
-            }
+            level = on ? L_ON : L_OFF;
+            sprintf(str,"Level Mode %s \n", on ? "ON" : "OFF");
+            putsUart0(str);
 
-            // Phase
-            token = strtok(NULL, " \r\n");
-            // Determine if Phase set else default Phase = 0 v
-            if (strlen(token) > 0)
-            {
-                Phase = atof(token);
-            }
-            else
-            {
-                Phase = 0;
-            }
+            sprintf(str,"Voltage OUT 1 %2.2f \n", DcVoltage);
+            putsUart0(str);
 
-            if (ok)
-            {
-                putsUart0("triangle wave with: \n");
-                sprintf(str,"- Frequency = %2f \n", Frequency);
-                putsUart0(str);
-                sprintf(str,"- Amplitude = %2f \n", Amplitude);
-                putsUart0(str);
-                sprintf(str,"- Offset = %2f \n", offset);
-                putsUart0(str);
-                sprintf(str,"- Phase = %2f \n", Phase);
-                putsUart0(str);
-
-
-                // call square function
-                triangleFunction (DAC_SELECT, Frequency, Amplitude, offset, Phase);
-                countA = 0;
-                countB = 0;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+            sprintf(str,"IN 1 voltages  %2.2f \n", adcVoltageIn);
+            putsUart0(str);
 
+            sprintf(str," %2.2f voltages drop \n", DcVoltage - adcVoltageIn);
+            putsUart0(str);
         }
-        else if (strcmp(token, "sawtooth") == 0)
+        else
         {
-            valid = true;
-            DC = false;
-            // DAC Select (DACA or 0 (outA) ////  DACB or 1 (outB ))
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-
-            if ((strcmp(token, "daca") == 0) || (strcmp(token, "DACA") == 0) || (strcmp(token, "0") == 0))
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A";
-            }
-            else if ((strcmp(token, "dacb") == 0) || (strcmp(token, "DACB") == 0) || (strcmp(token, "1") == 0))
-            {
-                DAC_SELECT = DACB;
-                DAC_str = "DAC B";
-            }
-            else
-            {
-                DAC_SELECT = DACA;
-                DAC_str = "DAC A as default setting";
-            }
+            putsUart0("Error in write command arguments\n");
+        }
+    }
+    else
+    {
+        putsUart0("Level command supported with DC signal and resistive load, on DAC A\n");
+    }
+}
 
-            // Frequency
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Frequency = atof(token);
+// Times each shape builder (into the spare table, the output is not disturbed) and an
+// amplitude-only update on DAC A
+void benchCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[60];
+    uint8_t w;
+    uint32_t start;
+    uint32_t cycles;
+    WAVE_CONFIG config = waveConfig[DACA];
+    int16_t* shape;
+
+    flushChannelUpdate(DACA);                        // a table DAC A is waiting for is not spare
+    shape = claimSpareShape(DACA);
+    for (w = W_SINE; w <= W_SAWTOOTH; w++)
+    {
+        start = DWT_CYCCNT_R;
+        lutBuilders[w](shape, 0);
+        cycles = DWT_CYCCNT_R - start;
 
-            // Amplitude
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            Amplitude = atof(token);
+        sprintf(str,"%-10s %8u cycles  %8.1f us \n", waveNames[w], cycles, cycles / (SYSTEM_CLOCK / 1e6f));
+        putsUart0(str);
+    }
 
-            // Offset
-            token = strtok(NULL, " \r\n");
-            // Determine if offset set else default offset = 0 v
-            if (strlen(token) > 0)
-            {
-                offset = atof(token);
-            }
-            else
-            {
-                offset = 0;
-            }
+    buildLut(DACA, config.waveform, config.amplitude, config.offset, config.phase);
 
-            // Phase
-            token = strtok(NULL, " \r\n");
-            // Determine if Phase set else default Phase = 0 v
-            if (strlen(token) > 0)
-            {
-                Phase = atof(token);
-            }
-            else
-            {
-                Phase = 0;
-            }
+    start = DWT_CYCCNT_R;
+    buildLut(DACA, config.waveform, config.amplitude, config.offset, config.phase);
+    cycles = DWT_CYCCNT_R - start;
+    sprintf(str,"%-10s %8u cycles  %8.1f us \n", "Amplitude", cycles, cycles / (SYSTEM_CLOCK / 1e6f));
+    putsUart0(str);
 
-            if (ok)
-            {
-                putsUart0("sawtooth wave with: \n");
-                sprintf(str,"- Frequency = %2f \n", Frequency);
-                putsUart0(str);
-                sprintf(str,"- Amplitude = %2f \n", Amplitude);
-                putsUart0(str);
-                sprintf(str,"- Offset = %2f \n", offset);
-                putsUart0(str);
-                sprintf(str,"- Phase = %2f \n", Phase);
-                putsUart0(str);
-
-
-                // call sawtooth function
-                sawtoothFunction (DAC_SELECT, Frequency, Amplitude, offset, Phase);
-                countA = 0;
-                countB = 0;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
+    // Per-sample output cost of DAC A's current waveform, without and with interpolation
+    for (w = 0; w < 2; w++)
+    {
+        bool interpolate = interpolateA;
+        volatile uint16_t word;                      // a volatile sink keeps the calls in the loop
+        uint16_t i;
 
-        }
-        else if (strcmp(token, "stop") == 0)
+        interpolateA = (w == 1);
+        start = DWT_CYCCNT_R;
+        for (i = 0; i < 256; i++)
         {
-            valid = true;
+            word = calcSampleA();
+        }
+        cycles = (DWT_CYCCNT_R - start) / 256;
+        interpolateA = interpolate;
+        (void)word;
 
-            N_cycles_A = cycles_A;
-            N_cycles_B = cycles_B;
+        sprintf(str,"%-10s %8u cycles per sample \n", (w == 1) ? "Interp" : "Nearest", cycles);
+        putsUart0(str);
+    }
+}
 
-            TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer
-        }
-        else if (strcmp(token, "run") == 0)
-        {
-            valid = true;
+// Waveforms pick up the calibration at output time, only the DC level is stored as a code
+void applyCalibration()
+{
+    if (DC)
+    {
+        setOpampVoltageOut(DACSELECT, DcVoltage);
+    }
+}
 
-            TIMER1_CTL_R |= TIMER_CTL_TAEN;                 // turn-on timer
-        }
-        else if (strcmp(token, "pause") == 0)
+void calCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[160];
+    char *DAC_str;
+    DAC d;
+    CAL_COEFFS* cal;
+
+    if (data->fieldCount == 8)
+    {
+        d = getFieldDac(data, 1, &DAC_str);
+        cal = &calCoeffs[d];
+        cal->c3 = getFieldFloat(data, 2);
+        cal->c2 = getFieldFloat(data, 3);
+        cal->c1 = getFieldFloat(data, 4);
+        cal->c0 = getFieldFloat(data, 5);
+        cal->gain = getFieldFloat(data, 6);
+        cal->offset = getFieldFloat(data, 7);
+        buildCalTable(d);
+        applyCalibration();
+    }
+    else if (data->fieldCount > 2)
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+
+    for (d = DACA; d <= DACB; d++)
+    {
+        if (data->fieldCount == 1 || getFieldDac(data, 1, &DAC_str) == d)
         {
-            valid = true;
-            TIMER1_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer
+            cal = &calCoeffs[d];
+            snprintf(str, sizeof(str), "%s: %g %g %g %g, gain %g, offset %g \n", (d == DACA) ? "DAC A" : "DAC B",
+                    cal->c3, cal->c2, cal->c1, cal->c0, cal->gain, cal->offset);
+            putsUart0(str);
         }
-        else if (strcmp(token, "differential") == 0 || strcmp(token, "d") == 0) //////take d out
-        {
-            valid = true;
-            char str [20];
-            char *onoff;
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            if ((strcmp(token, "ON") == 0) || (strcmp(token, "on") == 0))
-            {
-                differential = ON;
-                onoff = "ON";
-            }
-            else  if ((strcmp(token, "OFF") == 0) || (strcmp(token, "off") == 0))
-            {
-                differential = OFF;
-                onoff = "OFF";
-            }
+    }
+}
 
-            if (ok)
-            {
-                sprintf(str,"Differential Mode %s \n", onoff);
-                putsUart0(str);
-                countA = 0;
-                countB = 0;
-            }
-            else
-            {
-                putsUart0("Error in write command arguments\n");
-            }
-        }
-        else if (strcmp(token, "reset") == 0)
+void sinetableCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[60];
+    DAC d;
+
+    if (isFieldEqual(data, 1, "quarter"))
+    {
+        sineTable = SINE_QUARTER;
+    }
+    else if (isFieldEqual(data, 1, "full"))
+    {
+        sineTable = SINE_FULL;
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+
+    // Move channels that are showing a sine to the selected table
+    for (d = DACA; d <= DACB; d++)
+    {
+        if (waveConfig[d].waveform == W_SINE)
         {
-            valid = true;
-            //reset the Microcontroller (Red board)
-            NVIC_APINT_R = NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ;
+            waveConfig[d].built = false;
+            buildLut(d, W_SINE, waveConfig[d].amplitude, waveConfig[d].offset, waveConfig[d].phase);
         }
-        else if (strcmp(token, "voltage") == 0)
-        {
-            valid = true;
-
-            uint16_t rawA;
-            uint16_t rawB;
-            float Vin;
+    }
 
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
+    sprintf(str,"Sine table %s, %u entries \n", (sineTable == SINE_QUARTER) ? "quarter-wave" : "full",
+            (sineTable == SINE_QUARTER) ? (1 << SINE_BITS) : LUT_SIZE);
+    putsUart0(str);
+}
 
-            if ((strcmp(token, "IN1") == 0) || (strcmp(token, "in1") == 0))
-            {
-                rawA = readAdc0Ss3();
-                Vin = ((float) rawA * 5.0) / 4096.0;
-                sprintf(str,"Voltage IN1  %2.2f \n", Vin);
-                putsUart0(str);
-            }
-            else  if ((strcmp(token, "IN2") == 0) || (strcmp(token, "in2") == 0))
+// Compares the sine paths against sinf over a fine phase sweep. The largest error bounds
+// the largest spur (a spur cannot exceed the peak error), so 20*log10(full scale / max error)
+// is a lower bound on SFDR; the phase truncation estimate is 6.02 dB per index bit.
+// The full-table rows measure a table built by buildSineLut in the spare shape buffer.
+void sfdrCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[128];
+    int16_t* shape;
+    uint8_t mode;
+    uint8_t bits;
+    uint32_t i;
+    uint32_t phase;
+    uint32_t step;
+    int32_t s0;
+    int32_t s1;
+    float error;
+    float maxError;
+    float h;
+
+    flushChannelUpdate(DACA);                        // a table DAC A is waiting for is not spare
+    shape = claimSpareShape(DACA);
+    buildSineLut(shape, 0);
+
+    // mode bit 0: quarter-wave table, bit 1: linear interpolation
+    for (mode = 0; mode < 4; mode++)
+    {
+        bits = (mode & 1) ? SINE_BITS : LUT_BITS;
+        step = 1u << (32 - bits);
+        maxError = 0;
+        for (i = 0; i < (1 << 16); i++)
+        {
+            phase = (i << 16) + 0x7FFF;
+            if (!(mode & 1))
             {
-                rawB = readAdc1Ss2();
-                Vin = ((float) rawB * 5.0) / 4096.0;
-                sprintf(str,"Voltage IN2  %2.2f \n", Vin);
-                putsUart0(str);
+                s0 = (mode & 2) ? calcShapeInterpolated(shape, phase) : shape[phase >> PHASE_SHIFT];
             }
             else
             {
-                putsUart0("Error in write command arguments\n");
+                s0 = calcQuarterSine(phase & ~(step - 1));
+                if (mode & 2)
+                {
+                    s1 = calcQuarterSine((phase & ~(step - 1)) + step);
+                    s0 += ((s1 - s0) * (int32_t)((phase >> (32 - bits - INTERP_BITS)) & ((1 << INTERP_BITS) - 1))) >> INTERP_BITS;
+                }
             }
-
+            error = s0 - 32767 * sinf(phase * (2 * PI_F / 4294967296.0f));
+            if (error < 0)
+                error = -error;
+            if (error > maxError)
+                maxError = error;
         }
-        else if (strcmp(token, "gain") == 0)
-        {
-            valid = true;
-            uint16_t rawA;
-            uint16_t rawB;
-            int n;
-            float VinA;
-            float VinB;
-            float GaindB;
-            float FREQ1;
-            float FREQ2;
-            float Freq = 0;
-
-
-            // Frequency 1
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            FREQ1 = atof(token);
-
-            // Frequency 2
-            token = strtok(NULL, " ");
-            ok = ok && token != NULL;
-            FREQ2 = atof(token);
-
-            if (ok)
-            {
-                sinusoidalFunction (DACA, FREQ1, 4,  0, 0); // sine wave function
-                N_cycles_A = -1;
 
-                putsUart0("---------------------------\n");
-                putsUart0("| Frequency  |  Gain (dB) |\n");
-                putsUart0("---------------------------\n");
+        // theory: 6.02 dB per index bit when truncating, h^2/8 peak error when interpolating
+        h = 2 * PI_F / (1 << bits);
+        snprintf(str, sizeof(str), "%-8s %-6s %5u entries %5u bytes: max error %6.2f LSB, SFDR >= %5.1f dB (%5.1f dB) \n",
+                (mode & 1) ? "Quarter" : "Full", (mode & 2) ? "interp" : "", 1 << bits,
+                (mode & 1) ? (QUARTER_SIZE + 1) * 2 : LUT_SIZE * 2,
+                maxError, 20 * log10f(32767 / maxError), (mode & 2) ? 20 * log10f(8 / (h * h)) : 6.02f * bits);
+        waitUart0TxFree(strlen(str));
+        putsUart0(str);
+    }
+}
+
+void interpCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[60];
+    char *DAC_str;
+    DAC d;
+    bool on;
 
-                if (FREQ1 == 0)
-                   n =0;
-                else
-                   n = log10(FREQ1);
+    d = getFieldDac(data, 1, &DAC_str);
+    if (getFieldOnOff(data, 2, &on))
+    {
+        if (d == DACA)
+            interpolateA = on;
+        else
+            interpolateB = on;
+        resetIsrStats();
+        selectTimer1Isr();                           // the handler reads a fixed table
+        sprintf(str,"Interpolation %s on %s \n", on ? "ON" : "OFF", DAC_str);
+        putsUart0(str);
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+    }
+}
 
-                Freq = FREQ1;
+void isrCommand(USER_DATA* data, uint8_t arg)
+{
+    if (isFieldEqual(data, 1, "fast"))
+    {
+        specializedIsr = true;
+    }
+    else if (isFieldEqual(data, 1, "generic"))
+    {
+        specializedIsr = false;
+    }
+    else
+    {
+        putsUart0("Error in write command arguments\n");
+        return;
+    }
+    selectTimer1Isr();
+    resetIsrStats();
+    putsUart0(specializedIsr ? "Specialized Timer1 handlers \n" : "Generic Timer1 handler \n");
+}
 
-                while (n <= 100)
-                {
-                    Step_Size_A = Freq/REF_FREQUENCY;
-                    _delay_cycles(50);
+void helpCommand(USER_DATA* data, uint8_t arg);
 
+const COMMAND commands[] =
+{
+    // name          alias   schema    handler              arg         help
+    {"dc",           NULL,   "XN",     dcCommand,           0,          "OUT, Voltage, calibrated by the cal tables"},
+    {"sine",         NULL,   "XNNnn",  waveformCommand,     W_SINE,     "OUT, FREQ, AMP, [OFS] [PH]"},
+    {"square",       NULL,   "XNNnn",  waveformCommand,     W_SQUARE,   "OUT, FREQ, AMP, [OFS] [PH]"},
+    {"sawtooth",     NULL,   "XNNnn",  waveformCommand,     W_SAWTOOTH, "OUT, FREQ, AMP, [OFS] [PH]"},
+    {"triangle",     NULL,   "XNNnn",  waveformCommand,     W_TRIANGLE, "OUT, FREQ, AMP, [OFS] [PH]"},
+    {"cycles",       NULL,   "XX",     cyclesCommand,       0,          "OUT, [N] or [continuous]"},
+    {"sweep",        NULL,   "XXnnaa", sweepCommand,        0,          "OUT, FREQ1, FREQ2, TIME, [LIN|LOG] [ONCE|REPEAT], or OUT OFF"},
+    {"mod",          NULL,   "An",     modCommand,          0,          "[AM|FM|PM] DEPTH or [OFF], DAC B modulates DAC A"},
+    {"arb",          NULL,   "XNNn",   arbCommand,          0,          "OUT, FREQ, AMP, [OFS] then binary block"},
+    {"stream",       NULL,   "XNNn",   streamCommand,       0,          "OUT, RATE, AMP, [OFS] then binary samples"},
+    {"capture",      NULL,   "XNNnn",  captureCommand,      0,          "IN, RATE, N, [PRE] [LEVEL] binary IN1/IN2 record"},
+    {"stop",         NULL,   "",       stopCommand,         0,          "stop wave form and start from time = 0"},
+    {"run",          NULL,   "",       runCommand,          0,          "run the last configured waveform or 0V"},
+    {"pause",        NULL,   "",       pauseCommand,        0,          "stop display the waveform"},
+    {"differential", "d",    "A",      differentialCommand, 0,          "[ON] or [OFF]"},
+    {"output",       NULL,   "A",      outputCommand,       0,          "[ISR] or [DMA]"},
+    {"ldac",         NULL,   "A",      ldacCommand,         0,          "[TIMER] or [GPIO] or [CS]"},
+    {"pipeline",     NULL,   "A",      pipelineCommand,     0,          "[ON] or [OFF]"},
+    {"isr",          NULL,   "A",      isrCommand,          0,          "[FAST] or [GENERIC] Timer1 handler"},
+    {"stats",        NULL,   "a",      statsCommand,        0,          "[reset] ISR cycles, jitter, overruns and UART buffers"},
+    {"rate",         NULL,   "x",      rateCommand,         0,          "[Hz] or [auto] sample rate, auto follows the configuration"},
+    {"voltage",      NULL,   "A",      voltageCommand,      0,          "IN"},
+    {"measure",      NULL,   "Nn",     measureCommand,      0,          "RATE, [N] mean, rms, min/max, p2p, freq of IN1 and IN2 over 2N samples"},
+    {"level",        NULL,   "A",      levelCommand,        0,          "[ON] or [OFF]"},
+    {"gain",         NULL,   "NNxa",   gainCommand,         0,          "FREQ1, FREQ2, [POINTS] [LOG|LIN] Bode table IN2/IN1"},
+    {"cal",          NULL,   "xnnnnnn", calCommand,         0,          "[OUT] [C3 C2 C1 C0 GAIN OFS] DAC calibration"},
+    {"sinetable",    NULL,   "A",      sinetableCommand,    0,          "[QUARTER] or [FULL] sine table"},
+    {"interp",       NULL,   "XA",     interpCommand,       0,          "OUT, [ON] or [OFF] linear interpolation"},
+    {"sfdr",         NULL,   "",       sfdrCommand,         0,          "sine table SFDR comparison"},
+    {"bench",        NULL,   "",       benchCommand,        0,          "table regeneration time per waveform"},
+    {"reset",        NULL,   "",       resetCommand,        0,          "reset the board"},
+    {"help",         NULL,   "",       helpCommand,         0,          "this list"},
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+void helpCommand(USER_DATA* data, uint8_t arg)
+{
+    char str[100];
+    uint8_t i;
 
-                    rawA = readAdc0Ss3();
-                    VinA = (rawA * 3.3) / 4096;
+    putsUart0("Commands:\n");
+    for (i = 0; i < COMMAND_COUNT; i++)
+    {
+        sprintf(str,"    %-10s %s \n", commands[i].name, commands[i].help);
+        waitUart0TxFree(strlen(str));                // the full list does not fit in the tx ring at once
+        putsUart0(str);
+    }
 
-                    rawB = readAdc1Ss2();
-                    VinB = (rawB * 3.3) / 4096;
+    waitUart0TxFree(512);
+    putsUart0("    Extra detail in the above commands: \n");
+    putsUart0("    OUT   DACA (0) or DACB (1) \n");
+    putsUart0("    FREQ  Frequency (Hz)\n");
+    putsUart0("    AMP   Amplitude (V)\n");
+    putsUart0("    [OFS] Offset   [optional] (default OFS is 0V.) \n");
+    putsUart0("    [PH]  Phase   [optional] (default PH is 0V.) \n");
+    putsUart0("    [PH] = 0.25  =>> pi/4 \n");
+    putsUart0("    [PH] = 0.5   =>> pi/2 \n");
+    putsUart0("    [PH] = 1.0   =>> pi\n");
+    putsUart0("    [PH] = 2.0   =>> 2*pi \n");
+}
 
-                    GaindB = 20 *  log10(VinB/VinA);
+// Looks up the first field in the command table and runs the handler once the
+// arguments match its schema
+void dispatchCommand(USER_DATA* data)
+{
+    uint8_t i;
 
-                    sprintf(str,"|%7.2f     |   %3.2f  |\n", Freq, GaindB); //, n, steps );
-                    putsUart0(str);
+    if (data->fieldCount == 0)
+        return;
 
-                    Freq = (1000 * n) / 10;
-                    n++;
-                    fflush(stdout);
-                }
-                sinusoidalFunction (DACA, 0, 0,  0, 0); // sine wave function
-            }
+    for (i = 0; i < COMMAND_COUNT; i++)
+    {
+        if (isFieldEqual(data, 0, commands[i].name) ||
+            ((commands[i].alias != NULL) && isFieldEqual(data, 0, commands[i].alias)))
+        {
+            if (isSchemaValid(data, commands[i].schema))
+                commands[i].handler(data, commands[i].arg);
             else
-            {
                 putsUart0("Error in write command arguments\n");
-            }
-
+            return;
         }
-        else if (strcmp(token, "level") == 0)
-        {
-            valid = true;
+    }
+    putsUart0("Invalid command\n");
+}
 
-            if (DC && (DACSELECT == DACA))
-            {
-                char str [20];
-                char *onoff;
-                token = strtok(NULL, " ");
-                ok = ok && token != NULL;
-                if ((strcmp(token, "ON") == 0) || (strcmp(token, "on") == 0))
-                {
-                    level = L_ON;
-                    onoff = "ON";
-                }
-                else  if ((strcmp(token, "OFF") == 0) || (strcmp(token, "off") == 0))
-                {
-                    level = L_OFF;
-                    onoff = "OFF";
-                }
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
 
-                if (ok )
-                {
-                    float adcVoltageIn;
-                    uint16_t rawA = readAdc0Ss3();
-                    adcVoltageIn = (rawA * 3.3) / 4096;
+int main(void)
+{
 
-                    sprintf(str,"Level Mode %s \n", onoff);
-                    putsUart0(str);
+    USER_DATA data;
 
-                    sprintf(str,"Voltage OUT 1 %2.2f \n", DcVoltage);
-                    putsUart0(str);
+    // Initialize hardware
+    initHw();
+    buildCalTable(DACA);
+    buildCalTable(DACB);
+    initTimer();
+    initUart0();
+    initAdc0Ss3();
+    initAdc1Ss2();
+    initCapture();
 
-                    sprintf(str,"IN 1 voltages  %2.2f \n", adcVoltageIn);
-                    putsUart0(str);
+    // Setup UART0 baud rate
+    setUart0BaudRate(UART0_BAUD, 40e6);
 
-                    sprintf(str," %2.2f voltages drop \n", DcVoltage - adcVoltageIn);
-                    putsUart0(str);
+    // Use AIN2 input with N=4 hardware sampling
+    setAdc0Ss3Mux(2);
+    setAdc0Ss3Log2AverageCount(2);
 
-                }
-                else
-                {
-                    putsUart0("Error in write command arguments\n");
-                }
-            }
-            else
-            {
-                putsUart0("Level command supported with DC signal and resistive load, on DAC A\n");
-            }
+    // Use AIN1 input with N=4 hardware sampling
+    setAdc1Ss2Mux(1);
+    setAdc1Ss2Log2AverageCount(2);
 
-        }
-        else if (strcmp(token, "help") == 0)
+    putsUart0("Welcome to the Project\n");
+    while (true)
+    {
+        putsUart0("Please enter a command or write help to see all the commands \n");
+        while (!getsUart0NonBlocking(data.buffer, MAX_CHARS))
         {
-            valid = true;
-            putsUart0("Commands:\n");
-            putsUart0("    dc         OUT, Voltage  \n");
-            putsUart0("    sine       OUT, FREQ, AMP, [OFS] [PH] \n");
-            putsUart0("    square     OUT, FREQ, AMP, [OFS] [PH]  \n");
-            putsUart0("    sawtooth   OUT, FREQ, AMP, [OFS] [PH] \n");
-            putsUart0("    triangle   OUT, FREQ, AMP, [OFS] [PH] \n");
-            putsUart0("    cycles     [N]    or [continuous] \n");
-            putsUart0("    stop       stop wave form and start from time = 0\n");
-            putsUart0("    run        run the last configured waveform or 0V\n");
-            putsUart0("    pause      stop display the waveform \n");
-            putsUart0("    differential    [ON] or [OFF] \n");
-            putsUart0("    voltage    IN \n");
-            putsUart0("    Level      [ON] or [OFF] \n");
-            putsUart0("    gain       FREQ1, FREQ2 \n");
-
-
-            putsUart0("    Extra detail in the above commands: \n");
-            putsUart0("    OUT   DACA (0) or DACB (1) \n");
-            putsUart0("    FREQ  Frequency (Hz)\n");
-            putsUart0("    AMP   Amplitude (V)\n");
-            putsUart0("    [OFS] Offset   [optional] (default OFS is 0V.) \n");
-            putsUart0("    [PH]  Phase   [optional] (default PH is 0V.) \n");
-            putsUart0("    [PH] = 0.25  =>> pi/4 \n");
-            putsUart0("    [PH] = 0.5   =>> pi/2 \n");
-            putsUart0("    [PH] = 1.0   =>> pi\n");
-            putsUart0("    [PH] = 2.0   =>> 2*pi \n");
+            // the ISRs keep generating and the tx ring keeps draining while the line is typed
         }
 
-        if (!valid)
-            putsUart0("Invalid command\n");
+        parseFields(&data);
+        dispatchCommand(&data);
 
         putsUart0(" \n");
     }
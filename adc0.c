@@ -66,6 +66,33 @@ void setAdc0Ss3Mux(uint8_t input)
     ADC0_ACTSS_R |= ADC_ACTSS_ASEN3;                 // enable SS3 for operation
 }
 
+// Select the SS3 trigger: the processor (readAdc0Ss3) or the timer output trigger. With dma,
+// each result requests a uDMA transfer (sample interrupt enable) and the interrupt mask lets
+// the transfer-done interrupt through on the SS3 vector; without, results wait in the FIFO
+void setAdc0Ss3TimerTrigger(bool timer, bool dma)
+{
+    while (ADC0_ACTSS_R & ADC_ACTSS_BUSY);           // let a conversion in flight land
+    ADC0_ACTSS_R &= ~ADC_ACTSS_ASEN3;                // disable sample sequencer 3 (SS3) for programming
+    ADC0_EMUX_R &= ~ADC_EMUX_EM3_M;
+    if (timer)
+    {
+        ADC0_EMUX_R |= ADC_EMUX_EM3_TIMER;
+        ADC0_SSCTL3_R = ADC_SSCTL3_END0 | (dma ? ADC_SSCTL3_IE0 : 0);
+        if (dma)
+            ADC0_IM_R |= ADC_IM_MASK3;
+    }
+    else
+    {
+        ADC0_EMUX_R |= ADC_EMUX_EM3_PROCESSOR;
+        ADC0_SSCTL3_R = ADC_SSCTL3_END0;
+        ADC0_IM_R &= ~ADC_IM_MASK3;
+    }
+    ADC0_ISC_R = ADC_ISC_IN3;                        // clear a pending interrupt
+    while (!(ADC0_SSFSTAT3_R & ADC_SSFSTAT3_EMPTY))
+        (void)ADC0_SSFIFO3_R;                        // results of the old trigger source are stale
+    ADC0_ACTSS_R |= ADC_ACTSS_ASEN3;                 // enable SS3 for operation
+}
+
 // Request and read one sample from SS3
 int16_t readAdc0Ss3()
 {
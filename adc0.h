@@ -25,6 +25,7 @@
 void initAdc0Ss3();
 void setAdc0Ss3Log2AverageCount(uint8_t log2AverageCount);
 void setAdc0Ss3Mux(uint8_t input);
+void setAdc0Ss3TimerTrigger(bool timer, bool dma);
 int16_t readAdc0Ss3();
 
 #endif
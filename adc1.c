@@ -66,6 +66,33 @@ void setAdc1Ss2Mux(uint8_t input)
     ADC1_ACTSS_R |= ADC_ACTSS_ASEN2;                 // enable SS3 for operation
 }
 
+// Select the SS2 trigger: the processor (readAdc1Ss2) or the timer output trigger. With dma,
+// each result requests a uDMA transfer (sample interrupt enable) and the interrupt mask lets
+// the transfer-done interrupt through on the SS2 vector; without, results wait in the FIFO
+void setAdc1Ss2TimerTrigger(bool timer, bool dma)
+{
+    while (ADC1_ACTSS_R & ADC_ACTSS_BUSY);           // let a conversion in flight land
+    ADC1_ACTSS_R &= ~ADC_ACTSS_ASEN2;                // disable sample sequencer 2 (SS2) for programming
+    ADC1_EMUX_R &= ~ADC_EMUX_EM2_M;
+    if (timer)
+    {
+        ADC1_EMUX_R |= ADC_EMUX_EM2_TIMER;
+        ADC1_SSCTL2_R = ADC_SSCTL2_END0 | (dma ? ADC_SSCTL2_IE0 : 0);
+        if (dma)
+            ADC1_IM_R |= ADC_IM_MASK2;
+    }
+    else
+    {
+        ADC1_EMUX_R |= ADC_EMUX_EM2_PROCESSOR;
+        ADC1_SSCTL2_R = ADC_SSCTL2_END0;
+        ADC1_IM_R &= ~ADC_IM_MASK2;
+    }
+    ADC1_ISC_R = ADC_ISC_IN2;                        // clear a pending interrupt
+    while (!(ADC1_SSFSTAT2_R & ADC_SSFSTAT2_EMPTY))
+        (void)ADC1_SSFIFO2_R;                        // results of the old trigger source are stale
+    ADC1_ACTSS_R |= ADC_ACTSS_ASEN2;                 // enable SS2 for operation
+}
+
 // Request and read one sample from SS2
 int16_t readAdc1Ss2()
 {
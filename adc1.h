@@ -25,6 +25,7 @@
 void initAdc1Ss2();
 void setAdc1Ss2Log2AverageCount(uint8_t log2AverageCount);
 void setAdc1Ss2Mux(uint8_t input);
+void setAdc1Ss2TimerTrigger(bool timer, bool dma);
 int16_t readAdc1Ss2();
 
 #endif
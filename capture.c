@@ -0,0 +1,281 @@
+// Capture Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// One timer output trigger starts ADC0 SS3 (IN1) and ADC1 SS2 (IN2) together, so
+// each pair of results is sampled at the same instant
+// Capture: Timer2A triggers, two uDMA channels interleave the pairs into a circular buffer
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "nvic.h"
+#include "udma.h"
+#include "adc0.h"
+#include "adc1.h"
+#include "capture.h"
+
+#define CAPTURE_CLOCK       40000000
+#define CAPTURE_BLOCKS      (CAPTURE_SIZE / CAPTURE_BLOCK)
+// Each channel writes its half of consecutive pairs
+#define CAPTURE_CONTROL     (UDMA_CHCTL_DSTINC_32 | UDMA_CHCTL_DSTSIZE_16 | UDMA_CHCTL_SRCINC_NONE | UDMA_CHCTL_SRCSIZE_16 | \
+                             UDMA_CHCTL_ARBSIZE_1 | ((CAPTURE_BLOCK - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_PINGPONG)
+
+typedef enum _CAPTURE_STATE
+{
+    CAPTURE_IDLE = 0,
+    CAPTURE_ARMED = 1,                      // filling the pre-trigger samples and looking for the trigger
+    CAPTURE_TRIGGERED = 2,                  // filling the post-trigger samples
+    CAPTURE_DONE = 3
+} CAPTURE_STATE;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+// The controller fills block after block, the primary structures the even blocks and the
+// alternate structures the odd ones; each finished structure is re-armed two blocks ahead
+ADC_PAIR captureBuffer[CAPTURE_SIZE];
+volatile CAPTURE_STATE captureState = CAPTURE_IDLE;
+volatile bool captureOverrun = false;
+uint32_t captureBlocks;                     // blocks finished since the start
+uint32_t captureTrigger;                    // sample number of the trigger
+uint16_t captureLength;
+uint16_t capturePre;
+bool captureLevelTrigger;
+uint16_t captureLevel;                      // rising crossing of this ADC code
+uint16_t capturePrevious;                   // last trigger input sample of the previous block
+CAPTURE_INPUT captureInput = CAPTURE_ADC0;  // input watched for the trigger
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void captureIsr();
+
+// Initialize Timer2 as the conversion clock and route both sequencers to uDMA
+// (initUdma, initAdc0Ss3 and initAdc1Ss2 must run first)
+void initCapture()
+{
+    // Enable clocks
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R2;
+    _delay_cycles(3);
+
+    TIMER2_CTL_R &= ~TIMER_CTL_TAEN;                 // turn-off timer before reconfiguring
+    TIMER2_CFG_R = TIMER_CFG_32_BIT_TIMER;           // configure as 32-bit timer (A+B)
+    TIMER2_TAMR_R = TIMER_TAMR_TAMR_PERIOD;          // configure for periodic mode (count down)
+    TIMER2_CTL_R = TIMER_CTL_TAOTE;                  // each timeout triggers the ADC
+    setCaptureRate(10000);
+
+    selectUdmaChannelSource(UDMA_CH_ADC0SS3, UDMA_ENC_ADC0SS3);
+    selectUdmaChannelSource(UDMA_CH_ADC1SS2, UDMA_ENC_ADC1SS2);
+
+    // Transfer-done interrupts arrive on the sequencer vectors, below the sample clock (Timer1)
+    setNvicVector(INT_ADC0SS3, captureIsr);
+    setNvicVector(INT_ADC1SS2, captureIsr);
+    NVIC_PRI4_R = (NVIC_PRI4_R & ~NVIC_PRI4_INT17_M) | (1 << NVIC_PRI4_INT17_S);
+    NVIC_PRI12_R = (NVIC_PRI12_R & ~NVIC_PRI12_INT50_M) | (1 << NVIC_PRI12_INT50_S);
+    enableNvicInterrupt(INT_ADC0SS3);
+    enableNvicInterrupt(INT_ADC1SS2);
+}
+
+// Switch both sequencers between the processor and the timer trigger together, so a
+// timer output trigger samples IN1 and IN2 at the same instant. Each switch empties the
+// FIFOs, so neither the next pass nor readAdc0Ss3/readAdc1Ss2 sees a stale result
+void setAdcPairTimerTrigger(bool timer, bool dma)
+{
+    setAdc0Ss3TimerTrigger(timer, dma);
+    setAdc1Ss2TimerTrigger(timer, dma);
+}
+
+// Read the results of one timer trigger, false until both conversions are in
+bool readAdcPair(ADC_PAIR* pair)
+{
+    if ((ADC0_SSFSTAT3_R & ADC_SSFSTAT3_EMPTY) || (ADC1_SSFSTAT2_R & ADC_SSFSTAT2_EMPTY))
+        return false;
+    pair->in1 = ADC0_SSFIFO3_R & 0x0FFF;
+    pair->in2 = ADC1_SSFIFO2_R & 0x0FFF;
+    return true;
+}
+
+// Run the conversion clock without uDMA, the pairs wait in the FIFOs for readAdcPair
+// (set the rate with setCaptureRate, stopCapture stops it)
+void startAdcPairClock()
+{
+    stopCapture();
+    setAdcPairTimerTrigger(true, false);
+    ADC0_OSTAT_R = ADC_OSTAT_OV3;                    // clear old overflows
+    ADC1_OSTAT_R = ADC_OSTAT_OV2;
+    TIMER2_TAV_R = TIMER2_TAILR_R;
+    TIMER2_CTL_R |= TIMER_CTL_TAEN;
+}
+
+// A FIFO overflowed since startAdcPairClock, pairs were lost and the rest may be misaligned
+bool isAdcPairOverflow()
+{
+    return (ADC0_OSTAT_R & ADC_OSTAT_OV3) || (ADC1_OSTAT_R & ADC_OSTAT_OV2);
+}
+
+// Point both channels' primary or alternate structure at a block
+void setCaptureBlock(bool alternate, uint32_t block)
+{
+    ADC_PAIR* pairs = &captureBuffer[(block % CAPTURE_BLOCKS) * CAPTURE_BLOCK];
+
+    setUdmaTransfer(UDMA_CH_ADC0SS3, alternate, &ADC0_SSFIFO3_R, &pairs->in1, CAPTURE_CONTROL);
+    setUdmaTransfer(UDMA_CH_ADC1SS2, alternate, &ADC1_SSFIFO2_R, &pairs->in2, CAPTURE_CONTROL);
+}
+
+// A block is finished once both channels have written their half of it
+bool isCaptureBlockDone(bool alternate)
+{
+    return getUdmaTransferMode(UDMA_CH_ADC0SS3, alternate) == UDMA_CHCTL_XFERMODE_STOP
+        && getUdmaTransferMode(UDMA_CH_ADC1SS2, alternate) == UDMA_CHCTL_XFERMODE_STOP;
+}
+
+// Set the conversion rate, returns the rate actually produced
+float setCaptureRate(float rate)
+{
+    uint32_t load;
+
+    if (rate > CAPTURE_MAX_RATE)
+        rate = CAPTURE_MAX_RATE;
+    if (rate < 1)
+        rate = 1;
+    load = (uint32_t)(CAPTURE_CLOCK / rate + 0.5f) - 1;
+    TIMER2_TAILR_R = load;
+    return (float)CAPTURE_CLOCK / (load + 1);
+}
+
+// Start filling the buffer with pairs from both inputs. The record holds length pairs,
+// pre of them before the trigger: the first rising crossing of level on the trigger input
+// once pre pairs are in, or the pair right after them without a level trigger
+void startCapture(CAPTURE_INPUT trigger, uint16_t length, uint16_t pre, bool levelTrigger, uint16_t level)
+{
+    stopCapture();
+
+    if (length > CAPTURE_MAX)
+        length = CAPTURE_MAX;
+    if (pre > length)
+        pre = length;
+    captureLength = length;
+    capturePre = pre;
+    captureLevelTrigger = levelTrigger;
+    captureLevel = level;
+    captureTrigger = pre;
+    captureBlocks = 0;
+    capturePrevious = 0xFFFF;                        // no crossing before the first sample
+    captureOverrun = false;
+    captureState = levelTrigger ? CAPTURE_ARMED : CAPTURE_TRIGGERED;
+    captureInput = trigger;
+
+    setCaptureBlock(false, 0);
+    setCaptureBlock(true, 1);
+    setAdcPairTimerTrigger(true, true);
+    enableUdmaChannel(UDMA_CH_ADC0SS3);
+    enableUdmaChannel(UDMA_CH_ADC1SS2);
+
+    TIMER2_TAV_R = TIMER2_TAILR_R;                   // full first period
+    TIMER2_CTL_R |= TIMER_CTL_TAEN;                  // turn-on timer
+}
+
+// Stop conversions and give the sequencers back to readAdc0Ss3 and readAdc1Ss2
+void stopCapture()
+{
+    TIMER2_CTL_R &= ~TIMER_CTL_TAEN;
+    disableUdmaChannel(UDMA_CH_ADC0SS3);
+    disableUdmaChannel(UDMA_CH_ADC1SS2);
+    setAdcPairTimerTrigger(false, false);
+    if (captureState != CAPTURE_DONE)
+        captureState = CAPTURE_IDLE;
+}
+
+bool isCaptureDone()
+{
+    return captureState == CAPTURE_DONE;
+}
+
+bool isCaptureTriggered()
+{
+    return captureState >= CAPTURE_TRIGGERED;
+}
+
+// The handler fell more than a block behind and the controller ran out of armed structures
+bool isCaptureOverrun()
+{
+    return captureOverrun;
+}
+
+// Returns pair index of the record, 0 is pre pairs before the trigger
+ADC_PAIR getCapturePair(uint16_t index)
+{
+    ADC_PAIR pair = captureBuffer[(captureTrigger - capturePre + index) % CAPTURE_SIZE];
+
+    pair.in1 &= 0x0FFF;
+    pair.in2 &= 0x0FFF;
+    return pair;
+}
+
+// Transfer-done handler: looks for the trigger in each finished block, stops once the
+// post-trigger pairs are in and re-arms the finished structures two blocks ahead
+void captureIsr()
+{
+    ADC_PAIR* block;
+    uint32_t first;
+    uint16_t sample;
+    uint16_t i;
+
+    ADC0_ISC_R = ADC_ISC_IN3;
+    ADC1_ISC_R = ADC_ISC_IN2;
+    if (!isUdmaChannelInterrupt(UDMA_CH_ADC0SS3) && !isUdmaChannelInterrupt(UDMA_CH_ADC1SS2))
+        return;
+    clearUdmaChannelInterrupt(UDMA_CH_ADC0SS3);
+    clearUdmaChannelInterrupt(UDMA_CH_ADC1SS2);
+
+    while (captureState != CAPTURE_DONE && isCaptureBlockDone(captureBlocks & 1))
+    {
+        block = &captureBuffer[(captureBlocks % CAPTURE_BLOCKS) * CAPTURE_BLOCK];
+        first = captureBlocks * CAPTURE_BLOCK;
+
+        if (captureState == CAPTURE_ARMED)
+        {
+            for (i = 0; i < CAPTURE_BLOCK && captureState == CAPTURE_ARMED; i++)
+            {
+                sample = (captureInput == CAPTURE_ADC0) ? block[i].in1 : block[i].in2;
+                if (first + i >= capturePre && capturePrevious < captureLevel && sample >= captureLevel)
+                {
+                    captureTrigger = first + i;
+                    captureState = CAPTURE_TRIGGERED;
+                }
+                capturePrevious = sample;
+            }
+        }
+        captureBlocks++;
+
+        if (captureState == CAPTURE_TRIGGERED && captureBlocks * CAPTURE_BLOCK >= captureTrigger + captureLength - capturePre)
+        {
+            captureState = CAPTURE_DONE;
+            stopCapture();
+        }
+        else
+            setCaptureBlock((captureBlocks - 1) & 1, captureBlocks + 1);
+    }
+
+    // Both structures of a channel finished before this ran, the channel has stopped
+    if (captureState != CAPTURE_DONE && (~UDMA_ENASET_R & ((1 << UDMA_CH_ADC0SS3) | (1 << UDMA_CH_ADC1SS2))))
+    {
+        captureOverrun = true;
+        captureState = CAPTURE_DONE;
+        stopCapture();
+    }
+}
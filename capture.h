@@ -0,0 +1,61 @@
+// Capture Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// One timer output trigger starts ADC0 SS3 (IN1) and ADC1 SS2 (IN2) together, so
+// each pair of results is sampled at the same instant
+// Capture: Timer2A triggers, two uDMA channels interleave the pairs into a circular buffer
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAPTURE_SIZE        512             // sample pairs in the circular buffer
+#define CAPTURE_BLOCK       32              // sample pairs per uDMA transfer
+#define CAPTURE_MAX         (CAPTURE_SIZE - 2 * CAPTURE_BLOCK)  // longest record, the block in flight must not reach it
+#define CAPTURE_MAX_RATE    250000          // 1 Msps ADC with 4x hardware averaging
+
+typedef enum _CAPTURE_INPUT
+{
+    CAPTURE_ADC0 = 0,                       // IN1, ADC0 SS3
+    CAPTURE_ADC1 = 1                        // IN2, ADC1 SS2
+} CAPTURE_INPUT;
+
+// Results of one trigger, sampled simultaneously
+typedef struct _ADC_PAIR
+{
+    uint16_t in1;                           // ADC0 SS3
+    uint16_t in2;                           // ADC1 SS2
+} ADC_PAIR;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initCapture();
+void setAdcPairTimerTrigger(bool timer, bool dma);
+bool readAdcPair(ADC_PAIR* pair);
+void startAdcPairClock();
+bool isAdcPairOverflow();
+float setCaptureRate(float rate);
+void startCapture(CAPTURE_INPUT trigger, uint16_t length, uint16_t pre, bool levelTrigger, uint16_t level);
+void stopCapture();
+bool isCaptureDone();
+bool isCaptureTriggered();
+bool isCaptureOverrun();
+ADC_PAIR getCapturePair(uint16_t index);
+
+#endif
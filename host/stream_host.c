@@ -0,0 +1,159 @@
+// Stream Ring Host Harness
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: Linux host (gcc), no hardware
+// Build and run from this directory:
+//   gcc -std=gnu99 -Wall -I.. -o stream_host stream_host.c ../stream.c && ./stream_host
+
+// Drives stream.c the way streamCommand and streamIsr do: a host that honours XON/XOFF
+// with a reaction delay feeds the ring, the sample engine reads it at a fixed rate.
+// Checks the flow control levels, that a flow character is asked for again until it is
+// committed, and the underrun and overrun counts. Exits non-zero on the first failure
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "stream.h"
+
+#define HOST_DELAY      200             // samples the host still sends after XOFF
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void check(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", what);
+        exit(1);
+    }
+    printf("ok:   %s\n", what);
+}
+
+// Fills the ring until flow control asks for XOFF, then lets the host's in-flight samples land
+void testXoff()
+{
+    STREAM_STATS stats;
+    uint16_t i;
+    char flow = 0;
+
+    initStream();
+    while (flow == 0)
+    {
+        writeStream(0);
+        flow = updateStreamFlow();
+    }
+    check(flow == XOFF && getStreamCount() == STREAM_XOFF_LEVEL, "XOFF at STREAM_XOFF_LEVEL (768)");
+    check(updateStreamFlow() == XOFF, "XOFF asked for again until committed");
+    commitStreamFlow(flow);
+    check(updateStreamFlow() == 0, "nothing to send once XOFF is committed");
+
+    for (i = 0; i < HOST_DELAY; i++)
+        writeStream(0);
+    getStreamStats(&stats);
+    check(stats.overruns == 0, "host reaction delay fits after XOFF");
+}
+
+// Plays the ring down until flow control asks for XON
+void testXon()
+{
+    int16_t sample;
+    char flow = 0;
+
+    while (flow == 0)
+    {
+        readStream(&sample);
+        flow = updateStreamFlow();
+    }
+    check(flow == XON && getStreamCount() == STREAM_XON_LEVEL, "XON at STREAM_XON_LEVEL (512)");
+    commitStreamFlow(flow);
+    check(updateStreamFlow() == 0, "nothing to send once XON is committed");
+}
+
+// A read from an empty open ring is an underrun, after closeStream it is the end
+void testUnderrun()
+{
+    STREAM_STATS stats;
+    int16_t sample;
+
+    while (getStreamCount() > 0)
+        readStream(&sample);
+    check(!readStream(&sample), "empty ring returns no sample");
+    readStream(&sample);
+    getStreamStats(&stats);
+    check(stats.underruns == 2, "two reads from the empty open ring are two underruns");
+
+    closeStream();
+    readStream(&sample);
+    getStreamStats(&stats);
+    check(stats.underruns == 2, "no underruns once the stream is closed");
+}
+
+// A host that ignores XOFF overflows the ring, one entry always stays empty
+void testOverrun()
+{
+    STREAM_STATS stats;
+    uint16_t i;
+
+    initStream();
+    for (i = 0; i < STREAM_SIZE + 100; i++)
+        writeStream((int16_t)i);
+    getStreamStats(&stats);
+    check(getStreamCount() == STREAM_SIZE - 1, "full ring holds STREAM_SIZE - 1 samples");
+    check(stats.overruns == 101, "samples beyond a full ring are counted as overruns");
+    check(stats.highWater == STREAM_SIZE - 1, "high water reaches a full ring");
+}
+
+// Host at twice the playback rate with flow control: the ring never overflows or runs dry
+void testSteadyState()
+{
+    STREAM_STATS stats;
+    int16_t sample;
+    uint32_t t;
+    uint32_t delay = 0;
+    bool paused = false;
+    char flow;
+
+    initStream();
+    for (t = 0; t < 100000; t++)
+    {
+        if (!paused || delay > 0)
+        {
+            writeStream(0);
+            writeStream(0);
+            if (delay > 0)
+                delay--;
+        }
+        flow = updateStreamFlow();
+        if (flow)
+        {
+            commitStreamFlow(flow);
+            paused = (flow == XOFF);
+            delay = paused ? HOST_DELAY / 2 : 0;
+        }
+        if (t > STREAM_SIZE / 2)
+            readStream(&sample);
+    }
+    getStreamStats(&stats);
+    check(stats.overruns == 0 && stats.underruns == 0, "steady state with flow control, no overruns or underruns");
+}
+
+int main(void)
+{
+    testXoff();
+    testXon();
+    testUnderrun();
+    testOverrun();
+    testSteadyState();
+    printf("all stream checks passed\n");
+    return 0;
+}
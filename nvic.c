@@ -17,10 +17,18 @@
 #include "nvic.h"
 #include "tm4c123gh6pm.h"
 
+#define NVIC_VECTOR_COUNT 155                        // 16 system exceptions + 139 interrupts
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+// SRAM copy of the vector table, the linker command file places .vtable at 0x20000000
+// which meets the 1024-byte alignment VTABLE needs for 155 vectors
+#pragma DATA_SECTION(vectorTable, ".vtable")
+#pragma DATA_ALIGN(vectorTable, 1024)
+void (*vectorTable[NVIC_VECTOR_COUNT])(void);
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -50,3 +58,22 @@ void setNvicInterruptPriority(uint8_t vectorNumber, uint8_t priority)
     *p |= priority << (vectorNumber % 4);
 }
 
+// Copy the active vector table to SRAM and use the copy, so handlers can be replaced at run time
+void relocateNvicVectorTable()
+{
+    uint8_t i;
+    void (**source)(void) = (void (**)(void)) NVIC_VTABLE_R;
+
+    if (source != vectorTable)
+    {
+        for (i = 0; i < NVIC_VECTOR_COUNT; i++)
+            vectorTable[i] = source[i];
+        NVIC_VTABLE_R = (uint32_t) vectorTable;
+    }
+}
+
+// Replace a handler in the relocated table, a single word write so it is safe while the interrupt is live
+void setNvicVector(uint8_t vectorNumber, void (*handler)(void))
+{
+    vectorTable[vectorNumber] = handler;
+}
@@ -26,5 +26,7 @@
 void enableNvicInterrupt(uint8_t vectorNumber);
 void disableNvicInterrupt(uint8_t vectorNumber);
 void setNvicInterruptPriority(uint8_t vectorNumber, uint8_t priority);
+void relocateNvicVectorTable();
+void setNvicVector(uint8_t vectorNumber, void (*handler)(void));
 
 #endif
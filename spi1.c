@@ -103,6 +103,19 @@ void writeSpi1Data(uint32_t data)
     while (SSI1_SR_R & SSI_SR_BSY);
 }
 
+// Non-blocking function that queues data in the tx fifo (only waits while the fifo is full)
+void queueSpi1Data(uint32_t data)
+{
+    while (!(SSI1_SR_R & SSI_SR_TNF));
+    SSI1_DR_R = data;
+}
+
+// Blocking function that waits until all queued data has been shifted out
+void waitSpi1Idle()
+{
+    while (SSI1_SR_R & SSI_SR_BSY);
+}
+
 // Reads data from the rx buffer after a write
 uint32_t readSpi1Data()
 {
@@ -33,6 +33,8 @@ void initSpi1(uint32_t pinMask);
 void setSpi1BaudRate(uint32_t clockRate, uint32_t fcyc);
 void setSpi1Mode(uint8_t polarity, uint8_t phase);
 void writeSpi1Data(uint32_t data);
+void queueSpi1Data(uint32_t data);
+void waitSpi1Idle();
 uint32_t readSpi1Data();
 
 #endif
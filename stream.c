@@ -0,0 +1,131 @@
+// Sample Stream Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration: -
+// Single producer (main loop, from the UART) and single consumer (sample engine)
+// ring of Q15 samples. Each index is written by one side only, so no locking is needed
+// No peripheral access: host/stream_host.c builds it with gcc and checks the flow control
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stream.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+int16_t streamBuffer[STREAM_SIZE];
+volatile uint16_t streamWriteIndex = 0;
+volatile uint16_t streamReadIndex = 0;
+volatile bool streamClosed = false;     // no more input, an empty ring is the end of the stream
+bool streamPaused = false;              // XOFF sent
+STREAM_STATS streamStats;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Empties the ring and clears the statistics for a new stream
+void initStream()
+{
+    streamWriteIndex = 0;
+    streamReadIndex = 0;
+    streamClosed = false;
+    streamPaused = false;
+    streamStats.samples = 0;
+    streamStats.underruns = 0;
+    streamStats.overruns = 0;
+    streamStats.highWater = 0;
+}
+
+// Marks the end of the input, the ring then drains without counting underruns
+void closeStream()
+{
+    streamClosed = true;
+}
+
+// Adds a sample, returns false and counts an overrun when the ring is full
+bool writeStream(int16_t sample)
+{
+    uint16_t next = (streamWriteIndex + 1) & (STREAM_SIZE - 1);
+    uint16_t count;
+
+    if (next == streamReadIndex)
+    {
+        streamStats.overruns++;
+        return false;
+    }
+    streamBuffer[streamWriteIndex] = sample;
+    streamWriteIndex = next;
+
+    count = getStreamCount();
+    if (count > streamStats.highWater)
+        streamStats.highWater = count;
+    return true;
+}
+
+// Takes the next sample, returns false when the ring is empty (an underrun while the stream is open)
+bool readStream(int16_t* sample)
+{
+    if (streamReadIndex == streamWriteIndex)
+    {
+        if (!streamClosed)
+            streamStats.underruns++;
+        return false;
+    }
+    *sample = streamBuffer[streamReadIndex];
+    streamReadIndex = (streamReadIndex + 1) & (STREAM_SIZE - 1);
+    streamStats.samples++;
+    return true;
+}
+
+uint16_t getStreamCount()
+{
+    return (streamWriteIndex - streamReadIndex) & (STREAM_SIZE - 1);
+}
+
+// One entry always stays empty to tell a full ring from an empty one
+uint16_t getStreamFree()
+{
+    return STREAM_SIZE - 1 - getStreamCount();
+}
+
+// Returns the flow control character the host should get now (XOFF when the ring is
+// nearly full, XON once it has drained to half), or 0 when nothing changes
+// The state only changes in commitStreamFlow, so a character that could not be sent is
+// asked for again
+char updateStreamFlow()
+{
+    uint16_t count = getStreamCount();
+
+    if (!streamPaused && count >= STREAM_XOFF_LEVEL)
+        return XOFF;
+    if (streamPaused && count <= STREAM_XON_LEVEL)
+        return XON;
+    return 0;
+}
+
+// Record that the host was sent a flow control character from updateStreamFlow
+void commitStreamFlow(char flow)
+{
+    if (flow == XOFF)
+        streamPaused = true;
+    if (flow == XON)
+        streamPaused = false;
+}
+
+void getStreamStats(STREAM_STATS* stats)
+{
+    *stats = streamStats;
+}
@@ -0,0 +1,53 @@
+// Sample Stream Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration: -
+// No peripheral access, the ring and its flow control can also be built and
+// exercised on a host against a pseudo-terminal
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STREAM_SIZE         1024            // samples, power of 2
+#define STREAM_XOFF_LEVEL   (STREAM_SIZE - 256)  // leaves room for what the host sends after XOFF
+#define STREAM_XON_LEVEL    (STREAM_SIZE / 2)
+#define XON                 0x11
+#define XOFF                0x13
+
+typedef struct _STREAM_STATS
+{
+    uint32_t samples;                   // samples taken by the sample engine
+    uint32_t underruns;                 // samples due while the ring was empty
+    uint32_t overruns;                  // samples discarded because the ring was full
+    uint16_t highWater;                 // most samples waiting in the ring
+} STREAM_STATS;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initStream();
+void closeStream();
+bool writeStream(int16_t sample);
+bool readStream(int16_t* sample);
+uint16_t getStreamCount();
+uint16_t getStreamFree();
+char updateStreamFlow();
+void commitStreamFlow(char flow);
+void getStreamStats(STREAM_STATS* stats);
+
+#endif
@@ -20,17 +20,37 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <ctype.h>
 #include "tm4c123gh6pm.h"
 #include "uart0.h"
+#include "nvic.h"
 
 // PortA masks
 #define UART_TX_MASK 2
 #define UART_RX_MASK 1
 
+// Ring buffer sizes (powers of 2 so the indices wrap with a mask)
+#define UART0_TX_BUFFER_SIZE 1024
+#define UART0_RX_BUFFER_SIZE 256
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+// TX ring is filled by putcUart0 and drained by the ISR, RX ring is the opposite
+char txBuffer[UART0_TX_BUFFER_SIZE];
+volatile uint16_t txWriteIndex = 0;
+volatile uint16_t txReadIndex = 0;
+char rxBuffer[UART0_RX_BUFFER_SIZE];
+volatile uint16_t rxWriteIndex = 0;
+volatile uint16_t rxReadIndex = 0;
+
+volatile UART_STATS uart0Stats;
+
+// Line collected so far by getsUart0NonBlocking
+uint8_t lineCount = 0;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -67,6 +87,14 @@ void initUart0()
     UART0_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;    // configure for 8N1 w/ 16-level FIFO
     UART0_CTL_R = UART_CTL_TXE | UART_CTL_RXE | UART_CTL_UARTEN;
                                                         // enable TX, RX, and module
+
+    // Move data through the ring buffers from the ISR
+    UART0_IFLS_R = UART_IFLS_TX4_8 | UART_IFLS_RX4_8;   // interrupt when tx fifo drains / rx fifo fills to half
+    UART0_IM_R = UART_IM_TXIM | UART_IM_RXIM | UART_IM_RTIM;
+                                                        // turn-on tx, rx and rx time-out interrupts
+    NVIC_PRI1_R = (NVIC_PRI1_R & ~NVIC_PRI1_INT5_M) | (2 << NVIC_PRI1_INT5_S);
+                                                        // lower priority than the sample clock (Timer1)
+    enableNvicInterrupt(INT_UART0);
 }
 
 // Set baud rate as function of instruction cycle frequency
@@ -82,11 +110,94 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
                                                         // turn-on UART0
 }
 
-// Blocking function that writes a serial character when the UART buffer is not full
-void putcUart0(char c)
+// Moves characters from the tx ring to the hardware fifo until either is exhausted
+void fillTxFifoUart0()
+{
+    while (!(UART0_FR_R & UART_FR_TXFF) && (txReadIndex != txWriteIndex))
+    {
+        UART0_DR_R = txBuffer[txReadIndex];
+        txReadIndex = (txReadIndex + 1) & (UART0_TX_BUFFER_SIZE - 1);
+    }
+}
+
+// Services the rx fifo and refills the tx fifo. The tx ring is only touched on a tx
+// interrupt: putcUart0 masks TXIM while it primes the fifo, so the two never share it
+void uart0Isr()
+{
+    uint16_t next, used;
+    char c;
+
+    while (!(UART0_FR_R & UART_FR_RXFE))
+    {
+        c = UART0_DR_R & 0xFF;
+        next = (rxWriteIndex + 1) & (UART0_RX_BUFFER_SIZE - 1);
+        if (next == rxReadIndex)
+            uart0Stats.rxDropped++;
+        else
+        {
+            rxBuffer[rxWriteIndex] = c;
+            rxWriteIndex = next;
+            used = (rxWriteIndex - rxReadIndex) & (UART0_RX_BUFFER_SIZE - 1);
+            if (used > uart0Stats.rxHighWater)
+                uart0Stats.rxHighWater = used;
+        }
+    }
+    if (UART0_MIS_R & UART_MIS_TXMIS)
+        fillTxFifoUart0();
+    UART0_ICR_R = UART_ICR_TXIC | UART_ICR_RXIC | UART_ICR_RTIC;
+}
+
+// Non-blocking function that queues a serial character, returns false and drops it
+// when the tx ring is full
+bool putcUart0(char c)
+{
+    uint16_t next = (txWriteIndex + 1) & (UART0_TX_BUFFER_SIZE - 1);
+    uint16_t used;
+
+    if (next == txReadIndex)
+    {
+        uart0Stats.txDropped++;
+        return false;
+    }
+    txBuffer[txWriteIndex] = c;
+    txWriteIndex = next;
+    used = (txWriteIndex - txReadIndex) & (UART0_TX_BUFFER_SIZE - 1);
+    if (used > uart0Stats.txHighWater)
+        uart0Stats.txHighWater = used;
+
+    // The tx interrupt only fires when the fifo drains past its trigger level,
+    // so prime an idle fifo here with the ISR kept out of the ring
+    UART0_IM_R &= ~UART_IM_TXIM;
+    fillTxFifoUart0();
+    UART0_IM_R |= UART_IM_TXIM;
+    return true;
+}
+
+// Returns the number of characters that can be queued without being dropped
+uint16_t getUart0TxFree()
+{
+    return (UART0_TX_BUFFER_SIZE - 1) - ((txWriteIndex - txReadIndex) & (UART0_TX_BUFFER_SIZE - 1));
+}
+
+// Blocking function that waits until count characters can be queued
+void waitUart0TxFree(uint16_t count)
 {
-    while (UART0_FR_R & UART_FR_TXFF);               // wait if uart0 tx fifo full
-    UART0_DR_R = c;                                  // write character to fifo
+    if (count > UART0_TX_BUFFER_SIZE - 1)
+        count = UART0_TX_BUFFER_SIZE - 1;
+    while (getUart0TxFree() < count);
+}
+
+void getUart0Stats(UART_STATS* stats)
+{
+    *stats = uart0Stats;
+}
+
+void resetUart0Stats()
+{
+    uart0Stats.txDropped = 0;
+    uart0Stats.rxDropped = 0;
+    uart0Stats.txHighWater = 0;
+    uart0Stats.rxHighWater = 0;
 }
 
 //// Blocking function that writes a string
@@ -124,74 +235,75 @@ void putcUart0(char c)
 //    }
 //}
 
-void getsUart0(char str[], uint8_t size)
+// Non-blocking function that collects a line from the rx ring
+// Returns true once a complete line is in str, false while the line is still being typed
+bool getsUart0NonBlocking(char str[], uint8_t size)
 {
-    uint8_t count = 0;
     bool end = false;
     char c;
-    while(!end)
+    while (!end && kbhitUart0())
     {
         c = getcUart0();
-        end = (c == 13) || (count == size);
+        end = (c == 13) || (lineCount == size);
         if (!end)
         {
-            if ((c == 8 || c == 127) && count > 0)
-                count--;
+            if ((c == 8 || c == 127) && lineCount > 0)
+                lineCount--;
             if (c >= ' ' && c < 127)
-                str[count++] = c;
+                str[lineCount++] = c;
         }
     }
-    str[count] = '\0';
+    if (end)
+    {
+        str[lineCount] = '\0';
+        lineCount = 0;
+    }
+    return end;
+}
+
+// Returns true for characters that belong to a field
+bool isFieldChar(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
 }
 
-// Blocking function that parse  a string
+// Function that splits the buffer in place into alpha ('a') and numeric ('n') fields
+// Numeric fields start with a digit, or a sign or decimal point followed by a digit, and may
+// carry a decimal point and exponent (-1.5, .25, 2e3); other non-alphanumerics are delimiters
 void parseFields(USER_DATA *data)
 {
-    char c;
-    uint8_t position = 0;
-    uint8_t alphaNum = 0;
+    char c, next;
+    char type = 0;                      // type of the field being scanned, 0 between fields
     uint8_t index = 0;
 
-    c = data->buffer[index];
     data->fieldCount = 0;
-    if (((c > 47 && c < 58) || (c > 64 && c < 91) || (c > 96 && c < 123)))
-    {
-        alphaNum = 1;
-    }
-
-    while (data->buffer[index] != '\0')
+    while ((c = data->buffer[index]) != '\0')
     {
-
-        if (c > 47 && c < 58)
+        next = data->buffer[index + 1];
+        if (type == 0)
         {
-            if ((alphaNum == 1) && (data->fieldCount < MAX_FIELDS))
-            {
-                data->fieldType[position] = 'n';
-                data->fieldPosition[position] = index;
-                data->fieldCount++;
-                alphaNum = 0;
-                position++;
-            }
-        }
-        else if (((c > 64 && c < 91) || (c > 96 && c < 123)) && (data->fieldCount < MAX_FIELDS))
-        {
-            if (alphaNum == 1)
+            if ((c >= '0' && c <= '9') || ((c == '-' || c == '+' || c == '.') && (next >= '0' && next <= '9'))
+                || ((c == '-' || c == '+') && next == '.'))
+                type = 'n';
+            else if (isFieldChar(c))
+                type = 'a';
+            else
+                data->buffer[index] = '\0';
+
+            if (type != 0 && data->fieldCount < MAX_FIELDS)
             {
-                data->fieldType[position] = 'a';
-                data->fieldPosition[position] = index;
+                data->fieldType[data->fieldCount] = type;
+                data->fieldPosition[data->fieldCount] = index;
                 data->fieldCount++;
-                alphaNum = 0;
-                position++;
             }
         }
-        else
+        else if (!(isFieldChar(c) || (type == 'n' && c == '.')
+                   || (type == 'n' && (c == '-' || c == '+') && (data->buffer[index - 1] | 0x20) == 'e')))
         {
-            alphaNum = 1;
+            type = 0;
             data->buffer[index] = '\0';
         }
-
         index++;
-        c = data->buffer[index];
     }
 }
 
@@ -241,6 +353,49 @@ uint32_t getFieldInteger(USER_DATA* data, uint8_t fieldNumber)
     }
 }
 
+// Function that checks a numeric field is a plain unsigned integer that fits in 32 bits
+bool isFieldInteger(USER_DATA* data, uint8_t fieldNumber)
+{
+    char* field;
+    uint8_t i = 0;
+    uint32_t sum = 0;
+
+    if ((fieldNumber >= data->fieldCount) || (data->fieldType[fieldNumber] != 'n'))
+        return false;
+    field = &data->buffer[data->fieldPosition[fieldNumber]];
+    do
+    {
+        if (!isdigit(field[i]) || sum > (UINT32_MAX - (field[i] - '0')) / 10)
+            return false;
+        sum = sum * 10 + (field[i] - '0');
+        i++;
+    } while (field[i] != '\0');
+    return true;
+}
+
+// Function to return the value of a numeric field, including sign, decimals and exponent
+float getFieldFloat(USER_DATA* data, uint8_t fieldNumber)
+{
+    if ((fieldNumber < data->fieldCount) && (data->fieldType[fieldNumber] == 'n'))
+        return atof(&data->buffer[data->fieldPosition[fieldNumber]]);
+    else
+        return 0;
+}
+
+// Function that compares a field of any type against str, ignoring case
+bool isFieldEqual(USER_DATA* data, uint8_t fieldNumber, const char str[])
+{
+    char* field;
+    uint8_t i = 0;
+
+    if (fieldNumber >= data->fieldCount)
+        return false;
+    field = &data->buffer[data->fieldPosition[fieldNumber]];
+    while (field[i] != '\0' && tolower(field[i]) == tolower(str[i]))
+        i++;
+    return field[i] == '\0' && str[i] == '\0';
+}
+
 ////Blocking function to return  pointer of a field requested///////////////////////////
 //uint32_t strToFloat(char str[])
 //{
@@ -357,23 +512,30 @@ bool isCommand(USER_DATA* data, const char strCommand[],uint8_t minArguments)
     return Command;
 }
 
-// Blocking function that writes a string when the UART buffer is not full
+// Blocking function that queues a string, waiting for room in the tx ring so long
+// reports are paced by the line instead of losing text (main loop only)
 void putsUart0(char* str)
 {
     uint8_t i = 0;
     while (str[i] != '\0')
+    {
+        waitUart0TxFree(1);
         putcUart0(str[i++]);
+    }
 }
 
-// Blocking function that returns with serial data once the buffer is not empty
+// Blocking function that returns with serial data once the rx ring is not empty
 char getcUart0()
 {
-    while (UART0_FR_R & UART_FR_RXFE);               // wait if uart0 rx fifo empty
-    return UART0_DR_R & 0xFF;                        // get character from fifo
+    char c;
+    while (rxReadIndex == rxWriteIndex);             // wait if rx ring empty
+    c = rxBuffer[rxReadIndex];
+    rxReadIndex = (rxReadIndex + 1) & (UART0_RX_BUFFER_SIZE - 1);
+    return c;
 }
 
-// Returns the status of the receive buffer
+// Returns the status of the receive ring
 bool kbhitUart0()
 {
-    return !(UART0_FR_R & UART_FR_RXFE);
+    return rxReadIndex != rxWriteIndex;
 }
@@ -26,7 +26,7 @@
 //-----------------------------------------------------------------------------
 
 #define MAX_CHARS 250
-#define MAX_FIELDS 5
+#define MAX_FIELDS 8
 
 typedef struct _USER_DATA
 {
@@ -36,15 +36,30 @@ typedef struct _USER_DATA
     char fieldType[MAX_FIELDS];
 } USER_DATA;
 
+typedef struct _UART_STATS
+{
+    uint32_t txDropped;                 // characters discarded because the tx ring was full
+    uint32_t rxDropped;                 // characters discarded because the rx ring was full
+    uint16_t txHighWater;               // most characters waiting in the tx ring
+    uint16_t rxHighWater;               // most characters waiting in the rx ring
+} UART_STATS;
+
 void initUart0();
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc);
-void putcUart0(char c);
+bool putcUart0(char c);
 void putsUart0(char* str);
+uint16_t getUart0TxFree();
+void waitUart0TxFree(uint16_t count);
 //void getsUart0(USER_DATA* data);  // from lab 5
-void getsUart0(char str[], uint8_t size);  // from i2c utility Dr. Losh
+bool getsUart0NonBlocking(char str[], uint8_t size);
+void getUart0Stats(UART_STATS* stats);
+void resetUart0Stats();
 void parseFields(USER_DATA *data);
 char* getFieldString(USER_DATA* data,uint8_t fieldNumber);
 uint32_t getFieldInteger(USER_DATA* data, uint8_t fieldNumber);
+bool isFieldInteger(USER_DATA* data, uint8_t fieldNumber);
+float getFieldFloat(USER_DATA* data, uint8_t fieldNumber);
+bool isFieldEqual(USER_DATA* data, uint8_t fieldNumber, const char str[]);
 bool isCommand(USER_DATA* data, const char strCommand[],uint8_t minArguments);
 bool strcompare (char* str1, const char* str2);
 char getcUart0();
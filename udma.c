@@ -0,0 +1,102 @@
+// uDMA Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration: -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "udma.h"
+
+#define UDMA_CHANNELS      32
+#define UDMA_ALT_OFFSET    (UDMA_CHANNELS * 4)  // alternate structures follow the primary ones
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+// Channel control table: 4 words per channel (source end, destination end,
+// control word, unused), primary structures followed by alternate structures.
+// The controller requires the base address to be 1024-byte aligned.
+#pragma DATA_ALIGN(udmaControlTable, 1024)
+volatile uint32_t udmaControlTable[UDMA_CHANNELS * 4 * 2];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize uDMA controller
+void initUdma()
+{
+    // Enable clocks
+    SYSCTL_RCGCDMA_R |= SYSCTL_RCGCDMA_R0;
+    _delay_cycles(3);
+
+    UDMA_CFG_R = UDMA_CFG_MASTEN;                    // enable controller
+    UDMA_CTLBASE_R = (uint32_t)udmaControlTable;     // set channel control table base
+}
+
+// Select the peripheral that drives a channel (encoding from the channel assignment table)
+void selectUdmaChannelSource(uint8_t channel, uint8_t encoding)
+{
+    volatile uint32_t* p = (uint32_t*) &UDMA_CHMAP0_R;
+    p += channel / 8;
+    *p &= ~(0xF << ((channel % 8) * 4));
+    *p |= (uint32_t)encoding << ((channel % 8) * 4);
+
+    UDMA_USEBURSTCLR_R = 1 << channel;               // accept single and burst requests
+    UDMA_REQMASKCLR_R = 1 << channel;                // allow peripheral requests
+}
+
+// Program the primary or alternate structure of a channel
+// The end pointers are computed from the increment, size and transfer count in the control word
+void setUdmaTransfer(uint8_t channel, bool alternate, volatile void* source, volatile void* destination, uint32_t control)
+{
+    volatile uint32_t* entry = &udmaControlTable[(channel * 4) + (alternate ? UDMA_ALT_OFFSET : 0)];
+    uint32_t count = ((control & UDMA_CHCTL_XFERSIZE_M) >> UDMA_CHCTL_XFERSIZE_S) + 1;
+    uint32_t srcInc = (control & UDMA_CHCTL_SRCINC_M) >> 26;
+    uint32_t dstInc = (control & UDMA_CHCTL_DSTINC_M) >> 30;
+
+    entry[0] = (uint32_t)source + ((srcInc == 3) ? 0 : ((count - 1) << srcInc));
+    entry[1] = (uint32_t)destination + ((dstInc == 3) ? 0 : ((count - 1) << dstInc));
+    entry[2] = control;
+}
+
+// Returns the transfer mode of a structure, which the controller sets to STOP when the transfer completes
+uint32_t getUdmaTransferMode(uint8_t channel, bool alternate)
+{
+    return udmaControlTable[(channel * 4) + (alternate ? UDMA_ALT_OFFSET : 0) + 2] & UDMA_CHCTL_XFERMODE_M;
+}
+
+void enableUdmaChannel(uint8_t channel)
+{
+    UDMA_ALTCLR_R = 1 << channel;                    // start with the primary structure
+    UDMA_ENASET_R = 1 << channel;
+}
+
+void disableUdmaChannel(uint8_t channel)
+{
+    UDMA_ENACLR_R = 1 << channel;
+}
+
+// Transfer complete interrupts are delivered on the peripheral's vector, flagged here
+bool isUdmaChannelInterrupt(uint8_t channel)
+{
+    return (UDMA_CHIS_R & (1 << channel)) != 0;
+}
+
+void clearUdmaChannelInterrupt(uint8_t channel)
+{
+    UDMA_CHIS_R = 1 << channel;
+}
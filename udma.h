@@ -0,0 +1,44 @@
+// uDMA Library
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration: -
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef UDMA_H_
+#define UDMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Channel assignments used by this project (channel, encoding)
+#define UDMA_CH_TIMER1A         20
+#define UDMA_ENC_TIMER1A        0
+#define UDMA_CH_ADC0SS3         17
+#define UDMA_ENC_ADC0SS3        0
+#define UDMA_CH_ADC1SS2         26
+#define UDMA_ENC_ADC1SS2        1
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initUdma();
+void selectUdmaChannelSource(uint8_t channel, uint8_t encoding);
+void setUdmaTransfer(uint8_t channel, bool alternate, volatile void* source, volatile void* destination, uint32_t control);
+uint32_t getUdmaTransferMode(uint8_t channel, bool alternate);
+void enableUdmaChannel(uint8_t channel);
+void disableUdmaChannel(uint8_t channel);
+bool isUdmaChannelInterrupt(uint8_t channel);
+void clearUdmaChannelInterrupt(uint8_t channel);
+
+#endif